@@ -0,0 +1,188 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  A lazy sequence produced by a coroutine
+//  (until std::generator is available)
+//  ---------------------------------------------
+//  #include "generator.hpp" // MG::generator<>
+//  ---------------------------------------------
+#include <coroutine>
+#include <exception> // std::exception_ptr
+#include <iterator> // std::default_sentinel_t
+#include <memory> // std::addressof
+#include <type_traits> // std::conditional_t
+#include <utility> // std::exchange
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace MG
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// The yielded values aren't copied: the iterator refers to them until
+// the next increment
+// MG::generator<int> iota(int n) { while(true) co_yield n++; }
+template<typename T>
+class generator final
+{
+ public:
+    using value_type = std::remove_cvref_t<T>;
+    using reference = std::conditional_t<std::is_reference_v<T>, T, const T&>;
+
+    /////////////////////////////////////////////////////////////////////////
+    class promise_type final
+       {
+        private:
+            std::add_pointer_t<reference> m_value = nullptr;
+            std::exception_ptr m_exception;
+
+        public:
+            [[nodiscard]] generator get_return_object() noexcept { return generator{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+            [[nodiscard]] std::suspend_always initial_suspend() const noexcept { return {}; }
+            [[nodiscard]] std::suspend_always final_suspend() const noexcept { return {}; }
+            // A yielded temporary lives until the coroutine is resumed
+            [[nodiscard]] std::suspend_always yield_value(reference val) noexcept
+               {
+                m_value = std::addressof(val);
+                return {};
+               }
+            void return_void() const noexcept {}
+            void unhandled_exception() noexcept { m_exception = std::current_exception(); }
+
+            [[nodiscard]] reference value() const noexcept { return static_cast<reference>(*m_value); }
+            void rethrow_if_failed() const
+               {
+                if( m_exception )
+                   {
+                    std::rethrow_exception(m_exception);
+                   }
+               }
+       };
+
+    /////////////////////////////////////////////////////////////////////////
+    class iterator final
+       {
+        private:
+            std::coroutine_handle<promise_type> m_coro;
+
+        public:
+            using value_type = generator::value_type;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() noexcept = default;
+            explicit iterator(const std::coroutine_handle<promise_type> coro) noexcept : m_coro(coro) {}
+
+            [[nodiscard]] reference operator*() const noexcept { return m_coro.promise().value(); }
+            iterator& operator++()
+               {
+                resume(m_coro);
+                return *this;
+               }
+            void operator++(int) { ++*this; }
+            [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept { return not m_coro or m_coro.done(); }
+       };
+
+ private:
+    std::coroutine_handle<promise_type> m_coro;
+
+    explicit generator(const std::coroutine_handle<promise_type> coro) noexcept
+      : m_coro(coro)
+       {}
+
+ public:
+    generator(generator&& other) noexcept
+      : m_coro(std::exchange(other.m_coro, {}))
+       {}
+    generator& operator=(generator&& other) noexcept
+       {
+        if( this!=&other )
+           {
+            destroy();
+            m_coro = std::exchange(other.m_coro, {});
+           }
+        return *this;
+       }
+    generator(const generator&) = delete;
+    generator& operator=(const generator&) = delete;
+    ~generator() noexcept
+       {
+        destroy();
+       }
+
+    // Starts the coroutine, to be called once
+    [[nodiscard]] iterator begin()
+       {
+        resume(m_coro);
+        return iterator{m_coro};
+       }
+    [[nodiscard]] std::default_sentinel_t end() const noexcept { return {}; }
+
+ private:
+    static void resume(const std::coroutine_handle<promise_type> coro)
+       {
+        coro.resume();
+        coro.promise().rethrow_if_failed();
+       }
+
+    void destroy() noexcept
+       {
+        if( m_coro )
+           {
+            m_coro.destroy();
+            m_coro = {};
+           }
+       }
+};
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"MG::generator<>"> generator_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using ut::expect;
+    using ut::that;
+    using ut::throws;
+
+    ut::test("sequences") = []
+       {
+        int started = 0;
+        const auto iota = [&started](int n, const int last) -> MG::generator<int>
+           {
+            ++started;
+            while( n<=last ) co_yield n++;
+           };
+        auto gen = iota(1, 4);
+        expect( that % started==0 ) << "should be lazy\n";
+        int sum = 0;
+        for( const int i : gen ) sum += i;
+        expect( that % started==1 and sum==10 );
+
+        const auto evens = [](MG::generator<int> in) -> MG::generator<int>
+           {
+            for( const int i : in ) if( i%2==0 ) co_yield i;
+           };
+        sum = 0;
+        for( const int i : evens(iota(1, 10)) ) sum += i;
+        expect( that % sum==30 ) << "stages should chain\n";
+
+        std::string s = "abc";
+        const auto refs = [](std::string& str) -> MG::generator<std::string&> { co_yield str; };
+        for( std::string& r : refs(s) ) r += 'd';
+        expect( s=="abcd" ) << "references shouldn't copy\n";
+       };
+
+    ut::test("exceptions") = []
+       {
+        const auto failing = []() -> MG::generator<int>
+           {
+            co_yield 1;
+            throw std::runtime_error("failed");
+           };
+        expect( throws<std::runtime_error>([&failing]{ for( [[maybe_unused]] const int i : failing() ) ; }) );
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,610 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  The library blocks to be spliced in projects,
+//  kept in memory and optionally on disk
+//  ---------------------------------------------
+//  #include "library-cache.hpp" // ll::library_cache
+//  ---------------------------------------------
+#include <bit> // std::rotl, std::endian, std::byteswap
+#include <cstdint> // std::uint64_t
+#include <cstring> // std::memcpy
+#include <atomic>
+#include <future> // std::shared_future
+#include <list>
+#include <mutex>
+#include <memory> // std::shared_ptr
+#include <optional>
+#include <stdexcept> // std::runtime_error
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <fmt/core.h> // fmt::format
+#include <filesystem> // std::filesystem
+namespace fs = std::filesystem;
+
+#include "text.hpp" // text::Enc, text::to<>()
+#include "text-scan.hpp" // text::find_any_of<>()
+#include "memory_mapped_file.hpp" // sys::memory_mapped_file
+#include "splice_writer.hpp" // sys::splice_writer
+#include "parser-xml.hpp" // xml::Parser
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace ll
+{
+
+    namespace details
+       {
+        //-------------------------------------------------------------------
+        [[nodiscard]] inline std::uint64_t read_le64(const char* const p) noexcept
+           {
+            std::uint64_t val;
+            std::memcpy(&val, p, sizeof(val));
+            if constexpr( std::endian::native==std::endian::big ) val = std::byteswap(val);
+            return val;
+           }
+
+        //-------------------------------------------------------------------
+        [[nodiscard]] inline std::uint32_t read_le32(const char* const p) noexcept
+           {
+            std::uint32_t val;
+            std::memcpy(&val, p, sizeof(val));
+            if constexpr( std::endian::native==std::endian::big ) val = std::byteswap(val);
+            return val;
+           }
+       }
+
+//---------------------------------------------------------------------------
+// XXH64 of the given bytes, to recognize the contents
+[[nodiscard]] inline std::uint64_t hash64(const std::string_view bytes, const std::uint64_t seed =0) noexcept
+{
+    constexpr std::uint64_t P1 = 11400714785074694791ULL;
+    constexpr std::uint64_t P2 = 14029467366897019727ULL;
+    constexpr std::uint64_t P3 = 1609587929392839161ULL;
+    constexpr std::uint64_t P4 = 9650029242287828579ULL;
+    constexpr std::uint64_t P5 = 2870177450012600261ULL;
+    const auto round = [](std::uint64_t acc, const std::uint64_t input) noexcept -> std::uint64_t
+       {
+        acc += input * P2;
+        return std::rotl(acc, 31) * P1;
+       };
+    const auto merge = [&round](const std::uint64_t acc, const std::uint64_t val) noexcept -> std::uint64_t
+       {
+        return (acc ^ round(0, val)) * P1 + P4;
+       };
+
+    const char* p = bytes.data();
+    const char* const end = p + bytes.size();
+    std::uint64_t h;
+    if( bytes.size()>=32u )
+       {
+        std::uint64_t v1 = seed + P1 + P2;
+        std::uint64_t v2 = seed + P2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - P1;
+        for( ; p+32<=end; p+=32 )
+           {
+            v1 = round(v1, details::read_le64(p));
+            v2 = round(v2, details::read_le64(p+8));
+            v3 = round(v3, details::read_le64(p+16));
+            v4 = round(v4, details::read_le64(p+24));
+           }
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+       }
+    else
+       {
+        h = seed + P5;
+       }
+    h += bytes.size();
+
+    for( ; p+8<=end; p+=8 )
+       {
+        h ^= round(0, details::read_le64(p));
+        h = std::rotl(h, 27) * P1 + P4;
+       }
+    if( p+4<=end )
+       {
+        h ^= static_cast<std::uint64_t>(details::read_le32(p)) * P1;
+        h = std::rotl(h, 23) * P2 + P3;
+        p += 4;
+       }
+    for( ; p<end; ++p )
+       {
+        h ^= static_cast<std::uint64_t>(static_cast<unsigned char>(*p)) * P5;
+        h = std::rotl(h, 11) * P1;
+       }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// What tells if a file was modified without reading it
+struct file_stamp final
+   {
+    std::uintmax_t size = 0;
+    std::int64_t mtime = 0;
+
+    [[nodiscard]] constexpr bool operator==(const file_stamp&) const noexcept = default;
+   };
+
+//---------------------------------------------------------------------------
+[[nodiscard]] inline file_stamp file_stamp_of(const fs::path& pth)
+{
+    return { fs::file_size(pth), static_cast<std::int64_t>(fs::last_write_time(pth).time_since_epoch().count()) };
+}
+
+
+//---------------------------------------------------------------------------
+enum class library_kind : std::uint8_t
+   {
+    markup, // .plclib
+    text // .pll
+   };
+[[nodiscard]] inline library_kind library_kind_of(const fs::path& lib_pth)
+{
+    // The comparison should be case insensitive?
+    return lib_pth.extension()==".plclib" ? library_kind::markup : library_kind::text;
+}
+
+
+    namespace details
+       {
+        //-------------------------------------------------------------------
+        // Parsed just to check the nesting, the errors tell the line
+        template<text::Enc enc> void check_library_markup(const std::string_view lib_bytes)
+           {
+            xml::Parser<enc> parser{lib_bytes, xml::Engine::STRUCTURAL_INDEX};
+            parser.options().set_lazy_attributes(true);
+            parser.options().set_check_nesting(true);
+            parser.options().set_skip(xml::SkippableEvent::COMMENT);
+            parser.options().set_skip(xml::SkippableEvent::TEXT);
+            try{
+                while( parser.next_event() ) ;
+               }
+            catch( text::parse_error& e )
+               {
+                throw std::runtime_error( fmt::format("Malformed library: {} (line {})", e.what(), e.line()) );
+               }
+            catch( std::exception& e )
+               {
+                throw std::runtime_error( fmt::format("Malformed library: {} (line {})", e.what(), parser.curr_line()) );
+               }
+           }
+       }
+
+//---------------------------------------------------------------------------
+// The content of a library file as embedded in a project, given its bytes
+// without BOM: markup (.plclib), checked, without the leading spaces and
+// its xml declaration, plain text (.pll) as a CDATA section
+template<text::Enc enc>
+[[nodiscard]] std::string library_block(std::string_view lib_bytes, const library_kind kind)
+{
+    using namespace std::literals; // U"..."sv
+    constexpr std::size_t unit_size = text::code_unit_size<enc>;
+    if( kind==library_kind::markup )
+       {
+        details::check_library_markup<enc>(lib_bytes);
+        const auto skip_spaces = [&lib_bytes]() noexcept
+           {
+            while( lib_bytes.size()>=unit_size and text::is_space(text::details::code_unit_at<enc>(lib_bytes.data())) ) lib_bytes.remove_prefix(unit_size);
+           };
+        skip_spaces();
+        if( lib_bytes.starts_with(text::to<enc>(U"<?xml"sv)) )
+           {
+            const std::size_t decl_end = text::find_any_of<enc,U'>'>(lib_bytes, 0);
+            if( decl_end!=std::string_view::npos ) lib_bytes.remove_prefix(decl_end + unit_size);
+           }
+        return std::string{lib_bytes};
+       }
+
+    if( lib_bytes.find(text::to<enc>(U"]]>"sv))!=std::string_view::npos )
+       {
+        throw std::runtime_error("Library text contains \"]]>\"");
+       }
+    std::string block = text::to<enc>(U"<![CDATA["sv);
+    block.reserve(block.size() + lib_bytes.size() + 3u*unit_size);
+    block += lib_bytes;
+    block += text::to<enc>(U"]]>"sv);
+    return block;
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Library blocks ready to be spliced, in the encoding of the project
+// (libraries in other encodings are converted, just their content).
+// Files are recognized by canonical path, size and modification time;
+// when these change the content hash is compared before building the
+// block again. The least recently used blocks are dropped beyond a total
+// size, and if a directory is given they're also kept there across runs.
+// Can be shared by threads, files are read and converted unlocked by
+// just one of the threads asking for them, the others wait for it
+// ll::library_cache cache{1024*1024*256, "path/to/cache"};
+// std::shared_ptr<const std::string> block = cache.block_of<enc>(lib_pth);
+class library_cache final
+{
+ public:
+    using block_t = std::shared_ptr<const std::string>;
+    static constexpr std::size_t default_max_bytes = 256u * 1024u * 1024u;
+
+ private:
+    struct entry_t final
+       {
+        std::string key; // Canonical path and encoding
+        std::uintmax_t file_size = 0;
+        std::int64_t mtime = 0;
+        std::uint64_t content_hash = 0;
+        block_t block;
+       };
+
+    //  +-------+-----------+-------+--------------+------------+----------+------------+-----+-------+
+    //  | magic | file_size | mtime | content_hash | block_hash | key_size | block_size | key | block |
+    //  +-------+-----------+-------+--------------+------------+----------+------------+-----+-------+
+    static constexpr std::string_view disk_magic{"LLCACHE2"}; // Since the markup is checked
+    struct disk_header_t final
+       {
+        char magic[8];
+        std::uint64_t file_size;
+        std::int64_t mtime;
+        std::uint64_t content_hash;
+        std::uint64_t block_hash;
+        std::uint64_t key_size;
+        std::uint64_t block_size;
+       };
+
+    std::list<entry_t> m_entries; // Most recently used first
+    std::unordered_map<std::string, std::list<entry_t>::iterator> m_index;
+    std::unordered_map<std::string, std::shared_future<block_t>> m_loading; // Blocks being built
+    std::size_t m_max_bytes;
+    std::size_t m_bytes = 0;
+    fs::path m_dir;
+    std::mutex m_mutex; // Guards the entries and the ones being loaded
+    std::atomic<std::size_t> m_hits = 0;
+    std::atomic<std::size_t> m_misses = 0;
+
+ public:
+    explicit library_cache(const std::size_t max_bytes =default_max_bytes, fs::path dir ={})
+      : m_max_bytes(max_bytes)
+      , m_dir(std::move(dir))
+       {
+        if( not m_dir.empty() )
+           {
+            fs::create_directories(m_dir);
+           }
+       }
+
+    [[nodiscard]] std::size_t hits() const noexcept { return m_hits; }
+    [[nodiscard]] std::size_t misses() const noexcept { return m_misses; }
+    [[nodiscard]] std::size_t size() noexcept { std::scoped_lock lock(m_mutex); return m_entries.size(); }
+    [[nodiscard]] std::size_t bytes() noexcept { std::scoped_lock lock(m_mutex); return m_bytes; }
+
+    //-----------------------------------------------------------------------
+    // The library file read and converted only if not already known
+    template<text::Enc enc>
+    [[nodiscard]] block_t block_of(const fs::path& lib_pth)
+       {
+        const fs::path canonical_pth = fs::canonical(lib_pth);
+        const auto [file_size, mtime] = file_stamp_of(canonical_pth);
+        const std::string key = fmt::format("{}|{}", canonical_pth.string(), static_cast<int>(enc));
+
+        std::optional<entry_t> candidate;
+        std::promise<block_t> loaded;
+           {
+            std::unique_lock lock(m_mutex);
+            if( const auto it=m_index.find(key); it!=m_index.end() )
+               {
+                if( it->second->file_size==file_size and it->second->mtime==mtime )
+                   {
+                    ++m_hits;
+                    m_entries.splice(m_entries.begin(), m_entries, it->second);
+                    return it->second->block;
+                   }
+                candidate = *it->second; // Shares the block
+               }
+            if( const auto it=m_loading.find(key); it!=m_loading.end() )
+               {// Another thread is already at it
+                const std::shared_future<block_t> pending = it->second;
+                lock.unlock();
+                ++m_hits;
+                return pending.get();
+               }
+            m_loading.emplace(key, loaded.get_future().share());
+           }
+
+        try{
+            block_t block = load<enc>(canonical_pth, std::string{key}, file_size, mtime, std::move(candidate));
+            loaded.set_value(block);
+            stop_loading(key);
+            return block;
+           }
+        catch( ... )
+           {
+            loaded.set_exception( std::current_exception() );
+            stop_loading(key);
+            throw;
+           }
+       }
+
+ private:
+    //-----------------------------------------------------------------------
+    // Unlocked, from the disk cache or the file itself
+    template<text::Enc enc>
+    [[nodiscard]] block_t load(const fs::path& canonical_pth, std::string&& key, const std::uintmax_t file_size, const std::int64_t mtime, std::optional<entry_t>&& candidate)
+       {
+        if( not candidate and not m_dir.empty() )
+           {
+            candidate = load_entry(key);
+           }
+        if( candidate and candidate->file_size==file_size and candidate->mtime==mtime )
+           {
+            ++m_hits;
+            return store( std::move(*candidate), false );
+           }
+
+        // Changed or unknown, must read it
+        const sys::memory_mapped_file mapped{canonical_pth.string()};
+        std::string_view lib_bytes = mapped.as_string_view();
+        const std::uint64_t content_hash = hash64(lib_bytes);
+        if( candidate and candidate->content_hash==content_hash )
+           {// Just touched
+            ++m_hits;
+            candidate->file_size = file_size;
+            candidate->mtime = mtime;
+            return store( std::move(*candidate), true );
+           }
+
+        ++m_misses;
+        const auto [lib_enc, lib_bom_size] = text::detect_encoding_of(lib_bytes);
+        lib_bytes.remove_prefix(lib_bom_size);
+        const library_kind kind = library_kind_of(canonical_pth);
+        std::string block = lib_enc==enc ? library_block<enc>(lib_bytes, kind)
+                                         : library_block<enc>(text::re_encode_as<enc>(lib_enc, lib_bytes), kind);
+        return store( entry_t{std::move(key), file_size, mtime, content_hash, std::make_shared<const std::string>(std::move(block))}, true );
+       }
+
+    //-----------------------------------------------------------------------
+    void stop_loading(const std::string& key)
+       {
+        std::scoped_lock lock(m_mutex);
+        m_loading.erase(key);
+       }
+
+    //-----------------------------------------------------------------------
+    // As most recently used, saved on disk if new or changed
+    block_t store(entry_t&& entry, const bool save)
+       {
+        if( save and not m_dir.empty() )
+           {
+            save_entry(entry);
+           }
+
+        std::scoped_lock lock(m_mutex);
+        if( const auto it=m_index.find(entry.key); it!=m_index.end() )
+           {// Replaced in place
+            m_bytes -= it->second->block->size();
+            *it->second = std::move(entry);
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+           }
+        else
+           {
+            m_entries.push_front( std::move(entry) );
+            m_index[m_entries.front().key] = m_entries.begin();
+           }
+        m_bytes += m_entries.front().block->size();
+        block_t block = m_entries.front().block;
+
+        while( m_bytes>m_max_bytes and m_entries.size()>1 )
+           {// Evict the least recently used
+            m_bytes -= m_entries.back().block->size();
+            m_index.erase(m_entries.back().key);
+            m_entries.pop_back();
+           }
+        return block;
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] fs::path disk_path_of(const std::string_view key) const
+       {
+        return m_dir / fmt::format("{:016x}.llcache", hash64(key));
+       }
+
+    //-----------------------------------------------------------------------
+    // A broken or colliding file is just a miss
+    [[nodiscard]] std::optional<entry_t> load_entry(const std::string& key) const
+       {
+        const fs::path pth = disk_path_of(key);
+        std::error_code ec;
+        if( fs::file_size(pth, ec)<=sizeof(disk_header_t) or ec )
+           {
+            return std::nullopt;
+           }
+        try{
+            const sys::memory_mapped_file mapped{pth.string()};
+            const std::string_view bytes = mapped.as_string_view();
+            disk_header_t header;
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            if( std::string_view{header.magic, sizeof(header.magic)}!=disk_magic or
+                sizeof(header) + header.key_size + header.block_size!=bytes.size() or
+                bytes.substr(sizeof(header), header.key_size)!=key )
+               {
+                return std::nullopt;
+               }
+            const std::string_view block_bytes = bytes.substr(sizeof(header) + header.key_size);
+            if( hash64(block_bytes)!=header.block_hash )
+               {
+                return std::nullopt;
+               }
+            return entry_t{key, header.file_size, header.mtime, header.content_hash, std::make_shared<const std::string>(block_bytes)};
+           }
+        catch( std::exception& )
+           {
+            return std::nullopt;
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    // Written aside and renamed, best effort
+    void save_entry(const entry_t& entry) const noexcept
+       {
+        try{
+            disk_header_t header{};
+            std::memcpy(header.magic, disk_magic.data(), sizeof(header.magic));
+            header.file_size = entry.file_size;
+            header.mtime = entry.mtime;
+            header.content_hash = entry.content_hash;
+            header.block_hash = hash64(*entry.block);
+            header.key_size = entry.key.size();
+            header.block_size = entry.block->size();
+
+            sys::splice_writer out;
+            out.append_ref( std::string_view{reinterpret_cast<const char*>(&header), sizeof(header)} );
+            out.append_ref(entry.key);
+            out.append_ref(*entry.block);
+            const fs::path pth = disk_path_of(entry.key);
+            fs::path tmp_pth{pth};
+            tmp_pth += ".tmp";
+            out.write_to(tmp_pth);
+            fs::rename(tmp_pth, pth);
+           }
+        catch( std::exception& )
+           {
+           }
+       }
+};
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+#include "thread_pool.hpp" // MG::thread_pool
+static ut::suite<"ll::library_cache"> library_cache_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+    using ut::throws;
+
+    ut::test("hash64()") = []
+       {
+        expect( that % ll::hash64(""sv)==0xEF46DB3751D8E999ULL );
+        expect( that % ll::hash64("a"sv)==0xD24EC4F1A98C6E5BULL );
+        expect( that % ll::hash64("abc"sv)==0x44BC2CF5AD770999ULL );
+        const std::string long_str(1000, 'x');
+        expect( ll::hash64(long_str)!=ll::hash64(std::string_view{long_str}.substr(1)) );
+       };
+
+    ut::test("library_block()") = []
+       {
+        using enum ll::library_kind;
+        expect( ll::library_block<text::Enc::UTF8>("<?xml version=\"1.0\"?><plcLibrary/>"sv, markup)=="<plcLibrary/>"sv );
+        expect( ll::library_block<text::Enc::UTF8>("\n  <?xml version=\"1.0\"?>\n<plcLibrary/>"sv, markup)=="\n<plcLibrary/>"sv ) << "leading spaces\n";
+        expect( ll::library_block<text::Enc::UTF8>("IF a<b THEN"sv, text)=="<![CDATA[IF a<b THEN]]>"sv );
+        expect( ll::library_block<text::Enc::UTF8>("<b> := a;"sv, text)=="<![CDATA[<b> := a;]]>"sv ) << "kind isn't guessed\n";
+        expect( ll::library_block<text::Enc::UTF16LE>(text::to<text::Enc::UTF16LE>(U"<?xml?><à/>"sv), markup)==text::to<text::Enc::UTF16LE>(U"<à/>"sv) );
+        expect( throws<std::runtime_error>([]{ [[maybe_unused]] auto b = ll::library_block<text::Enc::UTF8>("x]]>"sv, text); }) );
+
+        std::string error;
+        try{ [[maybe_unused]] auto b = ll::library_block<text::Enc::UTF8>("\n  <?xml version=\"1.0\"?>\n<plcLibrary>\n<pou name=\"Z\">\n</plcLibrary>\n"sv, markup); }
+        catch( std::exception& e ) { error = e.what(); }
+        expect( that % error=="Malformed library: Close tag `plcLibrary` doesn't match `pou` (line 5)"sv ) << "got: " << error << '\n';
+        expect( throws<std::runtime_error>([]{ [[maybe_unused]] auto b = ll::library_block<text::Enc::UTF8>("<a><b></a>"sv, markup); }) );
+       };
+
+    ut::test("hits and misses") = []
+       {
+        const fs::path dir = fs::temp_directory_path() / "~llupdate-cache-test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        const fs::path lib_pth = dir / "lib.pll";
+        const auto write_lib = [&lib_pth](const std::string_view content)
+           {
+            sys::splice_writer out;
+            out.append_ref(content);
+            out.write_to(lib_pth);
+           };
+        write_lib("x := 1;"sv);
+
+        ll::library_cache cache{ll::library_cache::default_max_bytes, dir / "cache"};
+        const auto block = cache.block_of<text::Enc::UTF8>(lib_pth);
+        expect( *block=="<![CDATA[x := 1;]]>"sv );
+        expect( cache.block_of<text::Enc::UTF8>(lib_pth)==block ) << "should be shared\n";
+        expect( that % cache.hits()==1u and cache.misses()==1u );
+
+        fs::last_write_time(lib_pth, fs::last_write_time(lib_pth) + std::chrono::seconds(10));
+        expect( cache.block_of<text::Enc::UTF8>(lib_pth)==block ) << "touched file should be recognized by content\n";
+        expect( that % cache.hits()==2u and cache.misses()==1u );
+
+        write_lib("x := 2;"sv);
+        fs::last_write_time(lib_pth, fs::last_write_time(lib_pth) + std::chrono::seconds(20));
+        expect( *cache.block_of<text::Enc::UTF8>(lib_pth)=="<![CDATA[x := 2;]]>"sv );
+        expect( that % cache.misses()==2u and cache.size()==1u );
+        expect( *cache.block_of<text::Enc::UTF16LE>(lib_pth)==text::to<text::Enc::UTF16LE>(U"<![CDATA[x := 2;]]>"sv) ) << "should be converted to the project encoding\n";
+        expect( that % cache.misses()==3u and cache.size()==2u );
+
+        ll::library_cache other_run{ll::library_cache::default_max_bytes, dir / "cache"};
+        expect( *other_run.block_of<text::Enc::UTF8>(lib_pth)=="<![CDATA[x := 2;]]>"sv );
+        expect( that % other_run.hits()==1u and other_run.misses()==0u ) << "should be found on disk\n";
+
+        const fs::path bom_lib_pth = dir / "bom.plclib";
+        sys::splice_writer bom_lib;
+        bom_lib.append_ref("\xEF\xBB\xBF<?xml version=\"1.0\"?><lib à=\"1\"/>"sv);
+        bom_lib.write_to(bom_lib_pth);
+        expect( *cache.block_of<text::Enc::UTF16BE>(bom_lib_pth)==text::to<text::Enc::UTF16BE>(U"<lib à=\"1\"/>"sv) ) << "without the library BOM\n";
+
+        ll::library_cache small{8u};
+        const fs::path lib2_pth = dir / "lib2.pll";
+        fs::copy_file(lib_pth, lib2_pth);
+        [[maybe_unused]] const auto b1 = small.block_of<text::Enc::UTF8>(lib_pth);
+        [[maybe_unused]] const auto b2 = small.block_of<text::Enc::UTF8>(lib2_pth);
+        expect( that % small.size()==1u ) << "least recently used should be evicted\n";
+
+        fs::remove_all(dir);
+       };
+
+    ut::test("concurrent loads") = []
+       {
+        const fs::path dir = fs::temp_directory_path() / "~llupdate-cache-mt-test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        for( int i=0; i<4; ++i )
+           {
+            sys::splice_writer out;
+            out.append_copy( fmt::format("<lib{}/>", i) );
+            out.write_to(dir / fmt::format("lib{}.plclib", i));
+           }
+
+        ll::library_cache cache;
+        std::vector<std::future<ll::library_cache::block_t>> blocks;
+           {
+            MG::thread_pool pool(4);
+            for( int i=0; i<64; ++i )
+               {
+                blocks.push_back( pool.submit([&cache, pth=dir / fmt::format("lib{}.plclib", i%4)]{ return cache.block_of<text::Enc::UTF8>(pth); }) );
+               }
+           }
+        bool all_right = true;
+        for( std::size_t i=0; i<blocks.size(); ++i )
+           {
+            all_right = all_right and *blocks[i].get()==fmt::format("<lib{}/>", i%4u);
+           }
+        expect( all_right );
+        expect( that % cache.size()==4u and cache.misses()==4u and cache.hits()==60u ) << "each file should be loaded once\n";
+
+        fs::remove_all(dir);
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
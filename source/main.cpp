@@ -7,11 +7,20 @@
 #include <string_view>
 using namespace std::literals; // "..."sv
 #include <vector>
+#include <algorithm> // std::ranges::sort, std::max
+#include <charconv> // std::from_chars
+#include <cstdint> // std::uint8_t
+#include <thread> // std::thread::hardware_concurrency
 #include <fmt/core.h> // fmt::*
 #include <filesystem> // std::filesystem
 namespace fs = std::filesystem;
 
-#include "project-updater.hpp" // ll::update_project()
+#include "project-updater.hpp" // ll::update_project(), ll::update_projects()
+#include "timings.hpp" // sys::timings()
+
+
+/////////////////////////////////////////////////////////////////////////////
+enum class timings_format : std::uint8_t { none, text, json };
 
 
 /////////////////////////////////////////////////////////////////////////////
@@ -24,7 +33,11 @@ class Arguments final
             enum class STS
                {
                 SEE_ARG,
-                GET_OUTPATH
+                GET_OUTPATH,
+                GET_CACHEDIR,
+                GET_JOBS,
+                GET_DURABILITY,
+                GET_LIST
                } status = STS::SEE_ARG;
 
             for( int i=1; i<argc; ++i )
@@ -41,6 +54,47 @@ class Arguments final
                         status = STS::SEE_ARG;
                         break;
 
+                    case STS::GET_CACHEDIR :
+                        m_cache_dir = arg;
+                        status = STS::SEE_ARG;
+                        break;
+
+                    case STS::GET_LIST :
+                        add_projects_of_list(arg);
+                        status = STS::SEE_ARG;
+                        break;
+
+                    case STS::GET_JOBS :
+                        {
+                         const auto [ptr, ec] = std::from_chars(arg.data(), arg.data()+arg.size(), m_jobs);
+                         if( ec!=std::errc() or ptr!=arg.data()+arg.size() or m_jobs==0 )
+                            {
+                             throw std::invalid_argument( fmt::format("Invalid jobs count: {}",arg) );
+                            }
+                        }
+                        status = STS::SEE_ARG;
+                        break;
+
+                    case STS::GET_DURABILITY :
+                        if( arg=="none"sv )
+                           {
+                            m_options.sync = ll::durability::none;
+                           }
+                        else if( arg=="file"sv )
+                           {
+                            m_options.sync = ll::durability::file;
+                           }
+                        else if( arg=="full"sv )
+                           {
+                            m_options.sync = ll::durability::full;
+                           }
+                        else
+                           {
+                            throw std::invalid_argument( fmt::format("Invalid durability: {} (none, file or full)",arg) );
+                           }
+                        status = STS::SEE_ARG;
+                        break;
+
                     default :
                         if( arg.size()>=2 && arg[0]=='-' )
                            {// A command switch!
@@ -49,6 +103,46 @@ class Arguments final
                                {
                                 status = STS::GET_OUTPATH;
                                }
+                            else if( arg=="jobs"sv || arg=="j"sv )
+                               {
+                                status = STS::GET_JOBS;
+                               }
+                            else if( arg=="list"sv || arg=="l"sv )
+                               {
+                                status = STS::GET_LIST;
+                               }
+                            else if( arg=="cache-dir"sv )
+                               {
+                                status = STS::GET_CACHEDIR;
+                               }
+                            else if( arg=="durability"sv )
+                               {
+                                status = STS::GET_DURABILITY;
+                               }
+                            else if( arg=="manifest"sv )
+                               {
+                                m_options.use_manifest = true;
+                               }
+                            else if( arg=="index"sv )
+                               {
+                                m_options.use_index = true;
+                               }
+                            else if( arg=="timings"sv || arg=="timings=text"sv )
+                               {
+                                m_timings = timings_format::text;
+                               }
+                            else if( arg=="timings=json"sv )
+                               {
+                                m_timings = timings_format::json;
+                               }
+                            else if( arg=="check"sv )
+                               {
+                                m_check = true;
+                               }
+                            else if( arg=="quiet"sv || arg=="q"sv )
+                               {
+                                m_quiet = true;
+                               }
                             else if( arg=="verbose"sv || arg=="v"sv )
                                {
                                 m_verbose = true;
@@ -64,27 +158,22 @@ class Arguments final
                                }
                            }
                         else
-                           {// This must be the project path
-                            if( !m_prj_path.empty() )
-                               {
-                                throw std::invalid_argument( fmt::format("Project file was already set to {}",m_prj_path.string()) );
-                               }
-
-                            m_prj_path = arg;
-                            if( !fs::exists(m_prj_path) )
-                               {
-                                throw std::invalid_argument( fmt::format("File not found: {}",m_prj_path.string()) );
-                               }
+                           {// This must be a project path
+                            add_project(arg);
                            }
                    }
                } // each argument
 
             // The project path must be given
-            if( m_prj_path.empty() )
+            if( m_prj_paths.empty() )
                {
                 throw std::invalid_argument("Project file not given");
                }
-            if( fs::exists(m_out_path) && fs::equivalent(m_prj_path, m_out_path) )
+            if( !m_out_path.empty() && m_prj_paths.size()>1 )
+               {
+                throw std::invalid_argument("Output file can't be specified for more projects");
+               }
+            if( fs::exists(m_out_path) && fs::equivalent(m_prj_paths.front(), m_out_path) )
                {
                 throw std::runtime_error( fmt::format("Specified output file \"{}\" collides with original file",m_out_path.string()) );
                }
@@ -106,19 +195,125 @@ class Arguments final
     static void print_usage() noexcept
        {
         fmt::print( "\nUsage:\n"
-                    "   llupdate path/to/project.ppjs\n"
+                    "   llupdate path/to/project.ppjs [path/to/*.plcprj ...]\n"
                     "       --out/-o (Specify generated file)\n"
+                    "       --list/-l path/to/list.txt (Projects to update, one per line)\n"
+                    "       --cache-dir path/to/dir (Keep the converted libraries across runs)\n"
+                    "       --jobs/-j N (Max projects and libraries processed concurrently)\n"
+                    "       --durability none|file|full (Flush the written project, default: file)\n"
+                    "       --manifest (Keep aside what was applied, to skip unchanged projects)\n"
+                    "       --index (Keep aside where the libraries are, to skip parsing)\n"
+                    "       --check (Just tell the libraries not up to date)\n"
+                    "       --quiet/-q (Don't print the issues, with --check stop at the first)\n"
                     "       --verbose/-v (Print more info on stdout)\n"
+                    "       --timings[=json] (Print on stderr the time spent in each phase)\n"
                     "\n" );
        }
 
-    [[nodiscard]] const fs::path& prj_path() const noexcept { return m_prj_path; }
+    [[nodiscard]] const std::vector<fs::path>& prj_paths() const noexcept { return m_prj_paths; }
     [[nodiscard]] const fs::path& out_path() const noexcept { return m_out_path; }
+    [[nodiscard]] const fs::path& cache_dir() const noexcept { return m_cache_dir; }
+    [[nodiscard]] std::size_t jobs() const noexcept { return m_jobs; }
+    [[nodiscard]] const ll::update_options& options() const noexcept { return m_options; }
+    [[nodiscard]] bool check() const noexcept { return m_check; }
+    [[nodiscard]] bool quiet() const noexcept { return m_quiet; }
     [[nodiscard]] bool verbose() const noexcept { return m_verbose; }
+    [[nodiscard]] timings_format timings() const noexcept { return m_timings; }
 
  private:
-    fs::path m_prj_path;
+    //-----------------------------------------------------------------------
+    // Wildcards ('*' and '?') are expanded in the file name
+    void add_project(const std::string_view arg)
+       {
+        const fs::path pth{arg};
+        const std::string pattern{ pth.filename().string() };
+        if( pattern.find_first_of("*?")==std::string::npos )
+           {
+            if( !fs::exists(pth) )
+               {
+                throw std::invalid_argument( fmt::format("File not found: {}",pth.string()) );
+               }
+            m_prj_paths.push_back(pth);
+            return;
+           }
+
+        const fs::path dir{ pth.has_parent_path() ? pth.parent_path() : fs::path{"."} };
+        std::vector<fs::path> matching;
+        for( const fs::directory_entry& entry : fs::directory_iterator(dir) )
+           {
+            if( entry.is_regular_file() && matches_wildcard(entry.path().filename().string(), pattern) )
+               {
+                matching.push_back(entry.path());
+               }
+           }
+        if( matching.empty() )
+           {
+            throw std::invalid_argument( fmt::format("No files matching: {}",pth.string()) );
+           }
+        std::ranges::sort(matching);
+        m_prj_paths.insert(m_prj_paths.end(), matching.begin(), matching.end());
+       }
+
+    //-----------------------------------------------------------------------
+    // One project per line, relative to the list file directory,
+    // empty lines and lines starting with '#' are ignored
+    void add_projects_of_list(const std::string_view arg)
+       {
+        const fs::path list_pth{arg};
+        const sys::memory_mapped_file list_file{list_pth.string()};
+        std::string_view lines{ list_file.as_string_view() };
+        while( !lines.empty() )
+           {
+            const std::size_t eol = lines.find('\n');
+            std::string_view line{ lines.substr(0, eol) };
+            lines.remove_prefix(eol==std::string_view::npos ? lines.size() : eol+1);
+            while( !line.empty() && (line.back()=='\r' || line.back()==' ' || line.back()=='\t') ) line.remove_suffix(1);
+            while( !line.empty() && (line.front()==' ' || line.front()=='\t') ) line.remove_prefix(1);
+            if( line.empty() || line.front()=='#' ) continue;
+
+            const fs::path pth{line};
+            add_project( (pth.is_relative() ? list_pth.parent_path() / pth : pth).string() );
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] static bool matches_wildcard(const std::string_view name, const std::string_view pattern) noexcept
+       {
+        std::size_t n=0, p=0;
+        std::size_t star = std::string_view::npos, star_n = 0;
+        while( n<name.size() )
+           {
+            if( p<pattern.size() && (pattern[p]=='?' || pattern[p]==name[n]) )
+               {
+                ++n; ++p;
+               }
+            else if( p<pattern.size() && pattern[p]=='*' )
+               {
+                star = p++;
+                star_n = n;
+               }
+            else if( star!=std::string_view::npos )
+               {// Let the last star take one more char
+                p = star + 1;
+                n = ++star_n;
+               }
+            else
+               {
+                return false;
+               }
+           }
+        while( p<pattern.size() && pattern[p]=='*' ) ++p;
+        return p==pattern.size();
+       }
+
+    std::vector<fs::path> m_prj_paths;
     fs::path m_out_path;
+    fs::path m_cache_dir;
+    std::size_t m_jobs = std::thread::hardware_concurrency();
+    ll::update_options m_options;
+    bool m_check = false;
+    bool m_quiet = false;
+    timings_format m_timings = timings_format::none;
     bool m_verbose = false;
 };
 
@@ -150,27 +345,128 @@ class Arguments final
 //}
 
 
+/////////////////////////////////////////////////////////////////////////////
+// Collects the phases timings while alive, then prints them
+class timings_reporter final
+{
+ private:
+    timings_format m_format;
+
+ public:
+    explicit timings_reporter(const timings_format format) noexcept
+      : m_format(format)
+       {
+        if( m_format!=timings_format::none )
+           {
+            sys::timings().enable();
+           }
+       }
+
+    ~timings_reporter() noexcept
+       {
+        try{
+            if( m_format==timings_format::text )
+               {
+                fmt::print(stderr, "{}", sys::timings().report());
+               }
+            else if( m_format==timings_format::json )
+               {
+                fmt::print(stderr, "{}", sys::timings().report_json());
+               }
+           }
+        catch( ... ) {}
+       }
+
+    timings_reporter(const timings_reporter&) = delete;
+    timings_reporter& operator=(const timings_reporter&) = delete;
+};
+
+
 //---------------------------------------------------------------------------
 int main( const int argc, const char* const argv[] )
 {
     try{
         Arguments args(argc, argv);
+        const timings_reporter timings_report{args.timings()};
         if( args.verbose() )
            {
             fmt::print( "---- llupdate (ver. " __DATE__ ") ----\n" );
             fmt::print( "Running in: {}\n", fs::current_path().string() );
            }
 
+        ll::library_cache cache{ll::library_cache::default_max_bytes, args.cache_dir()};
+        MG::thread_pool pool(args.jobs()); // Joined before the cache is destroyed
+
+        if( args.prj_paths().size()>1 )
+           {
+            if( args.verbose() )
+               {
+                fmt::print( "{} {} projects\n", args.check() ? "Checking" : "Updating", args.prj_paths().size() );
+               }
+            const ll::batch_job job = !args.check() ? ll::batch_job::update : (args.quiet() ? ll::batch_job::check_until_stale : ll::batch_job::check);
+            const std::vector<ll::project_result> results = ll::update_projects(args.prj_paths(), job, args.options(), cache, pool, args.jobs());
+            int exit_code = 0;
+            for( const ll::project_result& result : results )
+               {
+                exit_code = std::max(exit_code, result.exit_code());
+                if( args.quiet() )
+                   {
+                    continue;
+                   }
+                if( !result.error.empty() )
+                   {
+                    fmt::print("!! {}: {}\n", result.path.string(), result.error);
+                   }
+                else if( !result.issues.empty() )
+                   {
+                    fmt::print("[!] {}: {} issues found\n", result.path.string(), result.issues.size());
+                    for( const auto& issue : result.issues )
+                       {
+                        fmt::print("    {}\n", issue);
+                       }
+                   }
+                else if( args.verbose() )
+                   {
+                    fmt::print("{}: {}\n", result.path.string(), args.check() ? "up to date"s : fmt::format("{} libraries updated", result.updated_count));
+                   }
+               }
+            if( args.verbose() )
+               {
+                fmt::print( "{} libraries cached, {} converted\n", cache.hits(), cache.misses() );
+               }
+            return exit_code;
+           }
+
         std::vector<std::string> issues;
+        ll::project_parsers parsers;
 
         if( args.verbose() )
            {
-            fmt::print( "Updating project {}\n", args.prj_path().string() );
+            fmt::print( "{} project {}\n", args.check() ? "Checking" : "Updating", args.prj_paths().front().string() );
+           }
+        if( args.check() )
+           {
+            const std::size_t stale_count = ll::check_project(args.prj_paths().front(), args.quiet(), args.options(), cache, pool, parsers, issues);
+            if( args.verbose() )
+               {
+                fmt::print( "{} libraries not up to date\n", stale_count );
+               }
+           }
+        else
+           {
+            const std::size_t updated_count = ll::update_project(args.prj_paths().front(), args.out_path(), args.options(), cache, pool, parsers, issues);
+            if( args.verbose() )
+               {
+                fmt::print( "{} libraries updated ({} cached, {} converted)\n", updated_count, cache.hits(), cache.misses() );
+               }
            }
-        ll::update_project(args.prj_path(), args.out_path(), issues);
 
         if( issues.size()>0 )
            {
+            if( args.quiet() )
+               {
+                return 1;
+               }
             fmt::print("[!] {} issues found\n", issues.size());
             for( const auto& issue : issues )
                {
@@ -9,6 +9,7 @@
 
 #include "os-detect.hpp" // MS_WINDOWS, POSIX
 #include "system_base.hpp" // sys::get_lasterr_msg()
+#include "timings.hpp" // sys::scoped_timer
 
 #if defined(POSIX)
   #include <fcntl.h> // open
@@ -37,6 +38,7 @@ class memory_mapped_file final
     explicit memory_mapped_file( std::string&& pth )
       : m_path(pth)
        {
+        scoped_timer timer{phase::mapping};
       #if defined(MS_WINDOWS)
         hFile = ::CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, nullptr);
         if(hFile==INVALID_HANDLE_VALUE)
@@ -75,6 +77,7 @@ class memory_mapped_file final
             throw std::runtime_error("Cannot map file");
            }
       #endif
+        timer.add_bytes(m_bufsiz);
        }
 
     ~memory_mapped_file() noexcept
@@ -96,11 +96,24 @@ class ParserBase final
         [[maybe_unused]] const bool has_next = get_next(); // Read first codepoint
        }
 
+    //-----------------------------------------------------------------------
+    // Start over on another buffer, keeping the issues callback
+    constexpr void reset(const std::string_view bytes) noexcept
+       {
+        m_buf = buffer_t{bytes};
+        m_line = 1;
+        m_offset = 0;
+        m_last_codepoint_byte_offset = 0;
+        m_curr_codepoint = text::null_codepoint;
+        [[maybe_unused]] const bool has_next = get_next();
+       }
+
     //-----------------------------------------------------------------------
     [[nodiscard]] constexpr bool has_bytes() const noexcept { return m_buf.has_bytes(); }
     [[nodiscard]] constexpr std::size_t curr_line() const noexcept { return m_line; }
     [[nodiscard]] constexpr std::size_t curr_offset() const noexcept { return m_offset; }
     [[nodiscard]] constexpr std::size_t curr_byte_offset() const noexcept { return m_buf.byte_pos(); }
+    [[nodiscard]] constexpr std::size_t curr_codepoint_byte_offset() const noexcept { return m_last_codepoint_byte_offset; }
     [[nodiscard]] constexpr char32_t curr_codepoint() const noexcept { return m_curr_codepoint; }
 
  public:
@@ -136,10 +149,27 @@ class ParserBase final
             notify_issue("! Truncated codepoint"sv);
             return true;
            }
+        m_last_codepoint_byte_offset = m_buf.byte_pos(); // The end
         m_curr_codepoint = text::null_codepoint;
         return false;
        }
 
+    //-----------------------------------------------------------------------
+    // Jump forward to a codepoint boundary located by other means
+    // (ex. a structural index) knowing the line ends in between
+    constexpr void advance_to_byte_offset(const std::size_t byte_pos, const std::size_t skipped_lines) noexcept
+       {
+        assert( byte_pos>=m_last_codepoint_byte_offset );
+        if( byte_pos>m_last_codepoint_byte_offset and has_codepoint() )
+           {
+            m_line += skipped_lines;
+            m_offset += text::count_codepoints<enc>(m_buf.get_view_between(m_last_codepoint_byte_offset, byte_pos)) - 1;
+            m_buf.restore_context( {byte_pos} );
+            m_curr_codepoint = text::null_codepoint; // Line ends already counted
+            [[maybe_unused]] const bool has_next = get_next();
+           }
+       }
+
     //-----------------------------------------------------------------------
     // Querying current codepoint
     [[nodiscard]] constexpr bool has_codepoint() noexcept
@@ -323,6 +353,16 @@ class ParserBase final
                }
             return a;
            }(end_block_arr);
+        using encoded_size_t = std::array<std::size_t, end_block_arr.size()>;
+        static constexpr encoded_size_t encoded_size = [](const end_block_arr_t& end_blk) constexpr
+           {
+            encoded_size_t a;
+            for(std::size_t i=0; i<a.size(); ++i)
+               {
+                a[i] = text::to<enc>(end_blk[i]).size();
+               }
+            return a;
+           }(end_block_arr);
 
 
         const auto start = save_context();
@@ -352,7 +392,7 @@ class ParserBase final
                        {// Last matches a codepoint in end block
                         if( preceding_match[i] )
                            {
-                            content_end_byte_pos = m_last_codepoint_byte_offset - i;
+                            content_end_byte_pos = m_last_codepoint_byte_offset - i*encoded_size[i];
                             ++i;
                             break;
                            }
@@ -595,6 +635,33 @@ static ut::suite<"text::ParserBase"> ParserBase_tests = []
         expect( parser.collect_bytes_until<U'-',U'-',U'>'>()=="---"sv and parser.got(U'a') );
        };
 
+    ut::test("end block edge case utf-16") = [&notify_sink]
+       {
+        text::ParserBase<UTF16LE> parser{ "-\0-\0-\0-\0-\0>\0a\0"sv };
+        parser.set_on_notify_issue(notify_sink);
+        expect( parser.collect_bytes_until<U'-',U'-',U'>'>()=="-\0-\0-\0"sv and parser.got(U'a') );
+       };
+
+    ut::test("jumping forward") = []
+       {
+        text::ParserBase<UTF8> parser{ "a\nà\n\nb"sv };
+        expect( parser.get_next() and parser.got_endline() and parser.curr_line()==1u );
+        parser.advance_to_byte_offset(6, 3);
+        expect( parser.got(U'b') and parser.curr_line()==4u and parser.curr_offset()==6u );
+        expect( not parser.get_next() and parser.curr_offset()==6u );
+       };
+
+    ut::test("reset") = []
+       {
+        text::ParserBase<UTF8> parser{ "a\nb"sv };
+        parser.skip_line();
+        expect( parser.got(U'b') and parser.curr_line()==2u );
+        parser.reset("xy"sv);
+        expect( parser.got(U'x') and parser.curr_line()==1u and parser.curr_offset()==1u and parser.curr_codepoint_byte_offset()==0u );
+        parser.reset(""sv);
+        expect( not parser.has_codepoint() );
+       };
+
     ut::test("numbers") = [&notify_sink]
        {
         text::ParserBase<UTF8> parser
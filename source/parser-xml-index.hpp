@@ -0,0 +1,214 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  Structural index of a xml buffer: stage 1
+//  of the two-stage xml tokenizer
+//  ---------------------------------------------
+//  #include "parser-xml-index.hpp" // xml::StructuralIndex
+//  ---------------------------------------------
+#include <cstdint> // std::uint64_t
+#include <bit> // std::countr_zero, std::popcount
+#include <array>
+#include <vector>
+#include <string_view>
+
+#include "text-scan.hpp" // text::mask_of_any<>()
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace xml
+{
+
+//---------------------------------------------------------------------------
+// The tokenizing strategy of xml::Parser
+enum class Engine : std::uint8_t
+   {
+    CODEPOINT =0 // Decode and test each codepoint
+   ,STRUCTURAL_INDEX // Jump between the positions of a precomputed structural index
+   };
+
+
+/////////////////////////////////////////////////////////////////////////////
+// One bit per code unit marking the structural codepoints (< > " ' &)
+// and the line ends, built in a single vectorized pass over the buffer.
+// Quoted regions are not masked here: in xml text an unbalanced quote is
+// legal, so quotes are paired only inside a tag while walking the index
+template<text::Enc enc>
+class StructuralIndex final
+{
+ public:
+    static constexpr std::size_t npos = std::string_view::npos;
+    static constexpr std::size_t unit_size = text::code_unit_size<enc>;
+
+    [[nodiscard]] static constexpr bool is_structural(const char32_t cp) noexcept
+       {
+        return cp==U'<' or cp==U'>' or cp==U'\"' or cp==U'\'' or cp==U'&';
+       }
+
+ private:
+    std::string_view m_bytes;
+    std::vector<std::uint64_t> m_structurals; // One mask every 64 code units
+    std::vector<std::uint64_t> m_endlines; // To count lines when jumping
+
+ public:
+    StructuralIndex() noexcept = default;
+
+    explicit StructuralIndex(const std::string_view bytes)
+       {
+        build(bytes);
+       }
+
+    //-----------------------------------------------------------------------
+    // Stage 1: classify all the code units
+    void build(const std::string_view bytes)
+       {
+        m_bytes = bytes;
+        const std::size_t blocks_count = (bytes.size()/unit_size + text::units_per_block - 1u) / text::units_per_block;
+        m_structurals.resize(blocks_count);
+        m_endlines.resize(blocks_count);
+        for( std::size_t i=0; i<blocks_count; ++i )
+           {
+            const std::size_t block_byte_pos = i * text::block_bytes<enc>;
+            m_structurals[i] = text::mask_of_any<enc,U'<',U'>',U'\"',U'\'',U'&'>(m_bytes, block_byte_pos);
+            m_endlines[i] = text::mask_of_any<enc,U'\n'>(m_bytes, block_byte_pos);
+           }
+       }
+
+    [[nodiscard]] constexpr std::string_view bytes() const noexcept { return m_bytes; }
+    [[nodiscard]] constexpr std::size_t blocks_count() const noexcept { return m_structurals.size(); }
+
+    //-----------------------------------------------------------------------
+    // Byte offset of the next structural codepoint cp at or after byte_pos
+    template<char32_t cp>
+    [[nodiscard]] constexpr std::size_t find_next(const std::size_t byte_pos) const noexcept
+       {
+        static_assert( is_structural(cp) );
+        const std::size_t unit = byte_pos / unit_size;
+        std::size_t i = unit / text::units_per_block;
+        if( i>=m_structurals.size() )
+           {
+            return npos;
+           }
+        std::uint64_t mask = m_structurals[i] & (~std::uint64_t{0} << (unit % text::units_per_block));
+        while( true )
+           {
+            while( mask )
+               {
+                const std::size_t pos = (i*text::units_per_block + static_cast<std::size_t>(std::countr_zero(mask))) * unit_size;
+                if( unit_at(pos)==cp )
+                   {
+                    return pos;
+                   }
+                mask &= mask - 1u; // Next bit
+               }
+            if( ++i>=m_structurals.size() )
+               {
+                return npos;
+               }
+            mask = m_structurals[i];
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    // Byte offset of the next ascii sequence ending with a structural
+    // codepoint, ex. find_sequence<U'-',U'-',U'>'>(pos) for a comment end
+    template<char32_t... seq>
+    [[nodiscard]] constexpr std::size_t find_sequence(const std::size_t byte_pos) const noexcept
+       {
+        static constexpr std::array<char32_t, sizeof...(seq)> seq_arr{seq...};
+        static constexpr std::size_t head_bytes = (seq_arr.size()-1u) * unit_size;
+        std::size_t pos = byte_pos + head_bytes;
+        while( (pos = find_next<seq_arr.back()>(pos))!=npos )
+           {
+            const std::size_t seq_pos = pos - head_bytes;
+            std::size_t i = 0;
+            while( i<seq_arr.size()-1u and unit_at(seq_pos + i*unit_size)==seq_arr[i] ) ++i;
+            if( i==seq_arr.size()-1u )
+               {
+                return seq_pos;
+               }
+            pos += unit_size;
+           }
+        return npos;
+       }
+
+    //-----------------------------------------------------------------------
+    // Number of line ends in the code units between two byte offsets
+    [[nodiscard]] constexpr std::size_t count_endlines(const std::size_t from_byte_pos, const std::size_t to_byte_pos) const noexcept
+       {
+        assert( from_byte_pos<=to_byte_pos );
+        const std::size_t from_unit = from_byte_pos / unit_size;
+        const std::size_t to_unit = to_byte_pos / unit_size;
+        const std::size_t i_from = from_unit / text::units_per_block;
+        const std::size_t i_to = to_unit / text::units_per_block;
+        const std::uint64_t from_mask = ~std::uint64_t{0} << (from_unit % text::units_per_block);
+        const std::uint64_t to_mask = ~(~std::uint64_t{0} << (to_unit % text::units_per_block));
+        if( i_from>=m_endlines.size() )
+           {
+            return 0;
+           }
+        if( i_from==i_to )
+           {
+            return static_cast<std::size_t>(std::popcount(m_endlines[i_from] & from_mask & to_mask));
+           }
+        std::size_t count = static_cast<std::size_t>(std::popcount(m_endlines[i_from] & from_mask));
+        for( std::size_t i=i_from+1u; i<i_to and i<m_endlines.size(); ++i )
+           {
+            count += static_cast<std::size_t>(std::popcount(m_endlines[i]));
+           }
+        if( i_to<m_endlines.size() )
+           {
+            count += static_cast<std::size_t>(std::popcount(m_endlines[i_to] & to_mask));
+           }
+        return count;
+       }
+
+ private:
+    [[nodiscard]] constexpr char32_t unit_at(const std::size_t byte_pos) const noexcept
+       {
+        assert( byte_pos+unit_size<=m_bytes.size() );
+        return text::details::code_unit_at<enc>(m_bytes.data() + byte_pos);
+       }
+};
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"xml::StructuralIndex"> StructuralIndex_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+    using enum text::Enc;
+
+    ut::test("utf-8") = []
+       {
+        const std::string buf = "<a x=\"1\">\n"s + std::string(100,'t') + "\n<!-- - -- -->\n</a>"s;
+        const xml::StructuralIndex<UTF8> idx{buf};
+        expect( that % idx.blocks_count()==3u );
+        expect( that % idx.find_next<U'<'>(0)==0u );
+        expect( that % idx.find_next<U'<'>(1)==111u );
+        expect( that % idx.find_next<U'\"'>(6)==7u );
+        expect( that % idx.find_next<U'&'>(0)==xml::StructuralIndex<UTF8>::npos );
+        expect( that % idx.find_sequence<U'-',U'-',U'>'>(114)==121u and idx.find_sequence<U'-',U'-',U'>'>(122)==xml::StructuralIndex<UTF8>::npos );
+        expect( that % idx.count_endlines(0, buf.size())==3u );
+        expect( that % idx.count_endlines(10, 110)==0u and idx.count_endlines(10, 111)==1u );
+        expect( that % idx.count_endlines(10, 10)==0u );
+       };
+
+    ut::test("utf-16be") = []
+       {
+        const std::string buf = text::to<UTF16BE>(U"<㰼>\n<!--x-->"sv);
+        const xml::StructuralIndex<UTF16BE> idx{buf};
+        expect( that % idx.find_next<U'<'>(2)==8u ) << "lookalike bytes shouldn't match\n";
+        expect( that % idx.find_next<U'>'>(0)==4u );
+        expect( that % idx.find_sequence<U'-',U'-',U'>'>(16)==18u );
+        expect( that % idx.count_endlines(0, buf.size())==1u );
+       };
+
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,473 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  Parse xml format splitting the buffer in
+//  chunks tokenized concurrently
+//  ---------------------------------------------
+//  #include "parser-xml-parallel.hpp" // xml::ParallelParser
+//  ---------------------------------------------
+#include <algorithm> // std::min, std::lower_bound
+#include <optional>
+#include <vector>
+#include <future> // std::future
+
+#include "parser-xml.hpp" // xml::Parser, xml::ParserEvent
+#include "text-scan.hpp" // text::find_any_of<>(), text::count_any_of<>()
+#include "thread_pool.hpp" // MG::thread_pool
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace xml
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// The buffer is split at '<' preceded by '>' and spaces, assuming that
+// there's no open comment, CDATA or quote there: each chunk is parsed
+// on its own by the pool, then the results are stitched in document order.
+// A chunk whose end couldn't be parsed means that the split was wrong
+// (or the document is malformed): the text is then parsed sequentially
+// from that point until an event start matches one of the next chunk
+template<text::Enc enc>
+class ParallelParser final
+{
+ public:
+    using Options = typename Parser<enc>::Options;
+    static constexpr std::size_t default_chunk_bytes = 1024u * 1024u;
+
+ private:
+    struct chunk_event_t final
+       {
+        ParserEvent event; // With absolute byte offsets
+        std::size_t line; // Relative to the chunk start
+       };
+
+    struct chunk_t final
+       {
+        std::size_t start_byte_pos = 0;
+        std::size_t end_byte_pos = 0;
+        std::vector<chunk_event_t> events;
+        std::optional<std::size_t> failed_byte_pos; // Start of the event that couldn't be parsed in the chunk
+        std::size_t endlines_count = 0;
+        std::future<void> done;
+       };
+
+    std::string_view m_bytes;
+    MG::thread_pool& m_pool;
+    Options m_options;
+    Engine m_engine;
+    std::vector<chunk_t> m_chunks;
+    std::size_t m_submitted_chunks = 0;
+    std::size_t m_max_chunks_in_flight;
+
+    std::size_t m_curr_chunk = 0; // The chunk being emitted
+    std::size_t m_curr_chunk_event = 0; // Next event of the current chunk
+    std::size_t m_endlines_before_curr_chunk = 0;
+
+    std::optional<Parser<enc>> m_sequential; // Parsing across a wrong split
+    std::size_t m_sequential_byte_pos = 0;
+    std::size_t m_sequential_endlines = 0;
+    std::size_t m_sequential_last_start = 0;
+    ParserEvent m_sequential_event; // With absolute byte offsets
+
+    ContentSpanTracker m_content_spans;
+    NestingChecker<enc> m_nesting;
+    NamespaceResolver m_namespaces;
+    ParserEvent m_none_event;
+    ParserEvent* m_event = &m_none_event;
+    std::size_t m_curr_line = 1;
+
+ public:
+    explicit ParallelParser(const std::string_view bytes, MG::thread_pool& pool, const Options& options ={}, const Engine engine =Engine::CODEPOINT, const std::size_t chunk_bytes =default_chunk_bytes)
+      : m_bytes(bytes)
+      , m_pool(pool)
+      , m_options(options)
+      , m_engine(engine)
+      , m_max_chunks_in_flight(2u * pool.size() + 1u)
+       {
+        split(std::max<std::size_t>(chunk_bytes, text::code_unit_size<enc>));
+        submit_chunks();
+       }
+
+    ~ParallelParser() noexcept
+       {// Tasks are referencing this
+        for( chunk_t& chunk : m_chunks )
+           {
+            if( chunk.done.valid() ) chunk.done.wait();
+           }
+       }
+
+    ParallelParser(const ParallelParser&) = delete;
+    ParallelParser& operator=(const ParallelParser&) = delete;
+
+    [[nodiscard]] constexpr std::size_t chunks_count() const noexcept { return m_chunks.size(); }
+    [[nodiscard]] constexpr Options const& options() const noexcept { return m_options; }
+    [[nodiscard]] constexpr ParserEvent const& curr_event() const noexcept { return *m_event; }
+    [[nodiscard]] constexpr std::string_view bytes() const noexcept { return m_bytes; } // The event spans refer to
+    [[nodiscard]] constexpr std::size_t curr_line() const noexcept { return m_curr_line; }
+    [[nodiscard]] constexpr LazyAttributes<enc> lazy_attributes() const noexcept { return LazyAttributes<enc>{m_bytes, m_event->attributes_region(), m_curr_line}; }
+    [[nodiscard]] NamespaceResolver::namespace_id_t namespace_id(const std::u32string_view uri) { return m_namespaces.namespace_id(uri); }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] ParserEvent const& next_event()
+       {
+        ParserEvent& event = next_stitched_event();
+        // Chunks begin inside elements, so these are done here in document order
+        try{
+            if( m_options.is_check_nesting() )
+               {
+                m_nesting.on_event(event, m_bytes);
+               }
+            if( m_options.is_resolve_namespaces() )
+               {
+                if( event.is_open_tag() )
+                   {
+                    if( m_options.is_lazy_attributes() )
+                       {
+                        auto attrs = lazy_attributes();
+                        m_namespaces.template declare_from<enc>(m_bytes, attrs.spans());
+                       }
+                    else
+                       {
+                        m_namespaces.template declare_from<enc>(m_bytes, event.attributes_spans());
+                       }
+                   }
+                m_namespaces.on_event(event);
+               }
+           }
+        catch( text::parse_error& )
+           {
+            throw;
+           }
+        catch( std::runtime_error& e )
+           {
+            throw text::parse_error(std::string(e.what()), m_curr_line);
+           }
+        return event;
+       }
+
+ private:
+    //-----------------------------------------------------------------------
+    [[nodiscard]] ParserEvent& next_stitched_event()
+       {
+        while( true )
+           {
+            if( m_sequential )
+               {
+                if( next_sequential_event() )
+                   {
+                    m_content_spans.on_event(m_sequential_event);
+                    return *m_event;
+                   }
+               }
+            else
+               {
+                chunk_t& chunk = m_chunks[m_curr_chunk];
+                if( chunk.done.valid() )
+                   {
+                    chunk.done.get(); // Propagates unexpected exceptions
+                   }
+                if( m_curr_chunk_event<chunk.events.size() )
+                   {
+                    chunk_event_t& ev = chunk.events[m_curr_chunk_event++];
+                    m_content_spans.on_event(ev.event); // Open tag could be in a previous chunk
+                    m_event = &ev.event;
+                    m_curr_line = ev.line + m_endlines_before_curr_chunk;
+                    return *m_event;
+                   }
+                else if( chunk.failed_byte_pos )
+                   {
+                    start_sequential( *chunk.failed_byte_pos );
+                   }
+                else if( m_curr_chunk+1u<m_chunks.size() )
+                   {// Chunk ended cleanly, so next one was split correctly
+                    enter_next_chunk();
+                   }
+                else
+                   {
+                    m_event = &m_none_event;
+                    return *m_event;
+                   }
+               }
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    void split(const std::size_t chunk_bytes)
+       {
+        constexpr std::size_t unit_size = text::code_unit_size<enc>;
+        std::vector<std::size_t> starts{0};
+        std::size_t pos = chunk_bytes;
+        while( pos<m_bytes.size() )
+           {
+            pos = find_chunk_start(pos - (pos % unit_size), starts.back());
+            if( pos==std::string_view::npos )
+               {
+                break;
+               }
+            starts.push_back(pos);
+            pos += chunk_bytes;
+           }
+
+        m_chunks.resize(starts.size());
+        for( std::size_t i=0; i<starts.size(); ++i )
+           {
+            m_chunks[i].start_byte_pos = starts[i];
+            m_chunks[i].end_byte_pos = i+1u<starts.size() ? starts[i+1u] : m_bytes.size();
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    // Next '<' preceded by '>' and spaces
+    [[nodiscard]] std::size_t find_chunk_start(std::size_t byte_pos, const std::size_t min_byte_pos) const noexcept
+       {
+        constexpr std::size_t unit_size = text::code_unit_size<enc>;
+        while( (byte_pos = text::find_any_of<enc,U'<'>(m_bytes, byte_pos))!=std::string_view::npos )
+           {
+            std::size_t prev = byte_pos;
+            char32_t cu = 0;
+            do{
+               prev -= unit_size;
+               cu = text::details::code_unit_at<enc>(m_bytes.data() + prev);
+              }
+            while( prev>min_byte_pos and text::is_space(cu) );
+            if( cu==U'>' )
+               {
+                return byte_pos;
+               }
+            byte_pos += unit_size;
+           }
+        return std::string_view::npos;
+       }
+
+    //-----------------------------------------------------------------------
+    void submit_chunks()
+       {
+        while( m_submitted_chunks<m_chunks.size() and m_submitted_chunks<m_curr_chunk+m_max_chunks_in_flight )
+           {
+            chunk_t& chunk = m_chunks[m_submitted_chunks++];
+            chunk.done = m_pool.submit([this, &chunk]{ parse_chunk(chunk); });
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    // Executed in the pool
+    void parse_chunk(chunk_t& chunk) const
+       {
+        const std::string_view chunk_bytes = m_bytes.substr(chunk.start_byte_pos, chunk.end_byte_pos-chunk.start_byte_pos);
+        chunk.endlines_count = text::count_any_of<enc,U'\n'>(chunk_bytes);
+        Parser<enc> parser{chunk_bytes, m_engine};
+        parser.options() = m_options;
+        parser.options().set_check_nesting(false);
+        parser.options().set_resolve_namespaces(false);
+        try{
+            while( const ParserEvent& event = parser.next_event() )
+               {
+                chunk.events.push_back( {event, parser.curr_line()} );
+                chunk.events.back().event.shift_byte_offsets( chunk.start_byte_pos );
+               }
+           }
+        catch( text::parse_error& )
+           {// Wrong split or malformed document, will be known when stitching
+            chunk.failed_byte_pos = chunk.start_byte_pos + parser.curr_event().start_byte_offset();
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    void enter_next_chunk()
+       {
+        m_endlines_before_curr_chunk += m_chunks[m_curr_chunk].endlines_count;
+        std::vector<chunk_event_t>().swap(m_chunks[m_curr_chunk].events); // Release memory
+        ++m_curr_chunk;
+        m_curr_chunk_event = 0;
+        submit_chunks();
+        if( m_chunks[m_curr_chunk].done.valid() )
+           {
+            m_chunks[m_curr_chunk].done.get();
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    void start_sequential(const std::size_t byte_pos)
+       {
+        const chunk_t& chunk = m_chunks[m_curr_chunk];
+        m_sequential_byte_pos = byte_pos;
+        m_sequential_endlines = m_endlines_before_curr_chunk + text::count_any_of<enc,U'\n'>(m_bytes.substr(chunk.start_byte_pos, byte_pos-chunk.start_byte_pos));
+        m_sequential_last_start = std::string_view::npos;
+        m_sequential.emplace( m_bytes.substr(byte_pos) ); // Expected to be short, no index
+        m_sequential->options() = m_options;
+        m_sequential->options().set_check_nesting(false);
+        m_sequential->options().set_resolve_namespaces(false);
+       }
+
+    //-----------------------------------------------------------------------
+    // Returns false when synced to a chunk
+    [[nodiscard]] bool next_sequential_event()
+       {
+        try{
+            m_sequential_event = m_sequential->next_event();
+           }
+        catch( text::parse_error& e )
+           {
+            throw text::parse_error(std::string(e.what()), e.line() + m_sequential_endlines);
+           }
+        m_event = &m_sequential_event;
+        m_curr_line = m_sequential->curr_line() + m_sequential_endlines;
+        if( not m_sequential_event )
+           {
+            return true;
+           }
+        m_sequential_event.shift_byte_offsets( m_sequential_byte_pos );
+        const std::size_t start = m_sequential_event.start_byte_offset();
+
+        // Entering the next chunks?
+        while( m_curr_chunk+1u<m_chunks.size() and start>=m_chunks[m_curr_chunk+1u].start_byte_pos )
+           {
+            enter_next_chunk();
+           }
+
+        // Try to sync with the current chunk (not on a deferred tag close)
+        if( start!=m_sequential_last_start )
+           {
+            const auto& events = m_chunks[m_curr_chunk].events;
+            const auto it = std::lower_bound(events.begin(), events.end(), start, [](const chunk_event_t& ev, const std::size_t pos){ return ev.event.start_byte_offset()<pos; });
+            if( it!=events.end() and it->event.start_byte_offset()==start )
+               {
+                m_curr_chunk_event = static_cast<std::size_t>(it - events.begin());
+                m_sequential.reset();
+                return false;
+               }
+           }
+        m_sequential_last_start = start;
+        return true;
+       }
+};
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+//---------------------------------------------------------------------------
+template<text::Enc enc>
+[[nodiscard]] std::vector<std::string> collect_parallel_events(const std::string_view buf, const xml::Engine engine, const std::size_t chunk_bytes, const bool check_nesting =false)
+   {
+    MG::thread_pool pool(3);
+    std::vector<std::string> events;
+    typename xml::Parser<enc>::Options options;
+    options.set_collect_comment_text(true);
+    options.set_collect_text_sections(true);
+    options.set_check_nesting(check_nesting);
+    xml::ParallelParser<enc> parser{buf, pool, options, engine, chunk_bytes};
+    try{
+        while( const xml::ParserEvent& event = parser.next_event() )
+           {
+            events.push_back( fmt::format("{} (bytes {}-{} inner {}-{} line {})", to_string(event), event.start_byte_offset(), event.end_byte_offset(), event.inner_byte_span().start, event.inner_byte_span().end, parser.curr_line()) );
+           }
+       }
+    catch( text::parse_error& e )
+       {
+        events.push_back( fmt::format("error (line {})", e.line()) );
+       }
+    return events;
+   }
+/////////////////////////////////////////////////////////////////////////////
+static ut::suite<"xml::ParallelParser"> ParallelParser_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+
+    // Plenty of "> <" in places where a split would be wrong
+    std::string buf = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                      "<plcProject name=\"test\">\n";
+    for( int i=0; i<8; ++i )
+       {
+        buf += fmt::format("  <pou name=\"FB{0}\" descr=\"a> <b\">\n"
+                           "    <!-- a comment> <with markup -->\n"
+                           "    <sourceCode><![CDATA[\n"
+                           "      IF a> <b THEN (* > <c> *) END_IF;\n"
+                           "    ]]></sourceCode>\n"
+                           "    <empty/>  <text>some text {0}</text>\n"
+                           "  </pou>\n", i);
+       }
+    buf += "</plcProject>\n";
+
+    ut::test("same events of xml::Parser") = [&buf]
+       {
+        const auto test_enc = [&buf]<text::Enc ENC>() -> void
+           {
+            const std::string bytes = text::re_encode<text::Enc::UTF8,ENC>(buf);
+            const auto expected = collect_events<ENC>(bytes, xml::Engine::CODEPOINT);
+            expect( that % expected.size()==91u );
+            for( std::size_t chunk_units : {1u, 2u, 3u, 5u, 8u, 13u, 21u} )
+               {
+                const std::size_t chunk_bytes = chunk_units * text::block_bytes<ENC> / 4u;
+                expect( collect_parallel_events<ENC>(bytes, xml::Engine::CODEPOINT, chunk_bytes)==expected ) << "chunk bytes " << chunk_bytes << '\n';
+                expect( collect_parallel_events<ENC>(bytes, xml::Engine::STRUCTURAL_INDEX, chunk_bytes)==expected ) << "chunk bytes " << chunk_bytes << '\n';
+               }
+           };
+        test_enc.template operator()<text::Enc::UTF8>();
+        test_enc.template operator()<text::Enc::UTF16LE>();
+        test_enc.template operator()<text::Enc::UTF32BE>();
+       };
+
+    ut::test("same errors of xml::Parser") = [&buf]
+       {
+        const auto test_err = [](const std::string& bytes) -> void
+           {
+            const auto expected = collect_events<text::Enc::UTF8>(bytes, xml::Engine::CODEPOINT);
+            expect( expected.back().starts_with("error"sv) );
+            for( std::size_t chunk_bytes : {16u, 40u, 100u, 300u} )
+               {
+                expect( collect_parallel_events<text::Enc::UTF8>(bytes, xml::Engine::CODEPOINT, chunk_bytes)==expected ) << "chunk bytes " << chunk_bytes << '\n';
+               }
+           };
+        test_err( buf + "<!-- unclosed\n\n"s );
+        std::string broken = buf;
+        broken.insert(broken.find("<empty/>", buf.size()/2), "<a x=\"1>\n"sv);
+        test_err( broken );
+
+        std::string mismatched = buf;
+        mismatched.replace(mismatched.find("</text>", buf.size()/2), 7, "</txt>"sv);
+        const auto expected = collect_events<text::Enc::UTF8>(mismatched, xml::Engine::CODEPOINT, true);
+        expect( that % expected.back()=="error (line 29)"sv );
+        for( std::size_t chunk_bytes : {16u, 40u, 100u, 300u} )
+           {
+            expect( collect_parallel_events<text::Enc::UTF8>(mismatched, xml::Engine::CODEPOINT, chunk_bytes, true)==expected ) << "chunk bytes " << chunk_bytes << '\n';
+           }
+        expect( that % collect_parallel_events<text::Enc::UTF8>(buf, xml::Engine::CODEPOINT, 100u, true).size()==91u ) << "chunks shouldn't be checked alone\n";
+       };
+
+    ut::test("namespaces") = []
+       {
+        std::string buf = "<prj xmlns=\"urn:ll\" xmlns:x=\"urn:x\">\n";
+        for( int i=0; i<20; ++i ) buf += "  <lib><x:item/>  <item xmlns=\"urn:other\"/></lib>\n";
+        buf += "</prj>\n";
+        MG::thread_pool pool(2);
+        typename xml::Parser<text::Enc::UTF8>::Options options;
+        options.set_resolve_namespaces();
+        xml::ParallelParser<text::Enc::UTF8> parser{buf, pool, options, xml::Engine::CODEPOINT, 64u};
+        const auto ll = parser.namespace_id(U"urn:ll");
+        const auto x = parser.namespace_id(U"urn:x");
+        std::size_t libs=0, x_items=0, items=0;
+        while( const xml::ParserEvent& event = parser.next_event() )
+           {
+            if( event.is_open_tag(ll, U"lib") ) ++libs;
+            else if( event.is_open_tag(x, U"item") ) ++x_items;
+            else if( event.is_open_tag(ll, U"item") ) ++items;
+           }
+        expect( that % parser.chunks_count()>1u and libs==20u and x_items==20u and items==0u );
+       };
+
+    ut::test("chunks") = [&buf]
+       {
+        MG::thread_pool pool(2);
+        const xml::ParallelParser<text::Enc::UTF8> parser{buf, pool, {}, xml::Engine::CODEPOINT, 256u};
+        expect( that % parser.chunks_count()>4u );
+        const xml::ParallelParser<text::Enc::UTF8> single{buf, pool};
+        expect( that % single.chunks_count()==1u );
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
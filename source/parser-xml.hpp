@@ -5,8 +5,18 @@
 //  #include "parser-xml.hpp" // xml::Parser
 //  ---------------------------------------------
 #include <algorithm> // std::min
+#include <concepts> // std::same_as
+#include <cstdint> // std::uint32_t
+#include <functional> // std::hash, std::equal_to
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility> // std::pair
+#include <vector>
 
 #include "parser-base.hpp" // text::parse_error, text::ParserBase
+#include "parser-xml-index.hpp" // xml::StructuralIndex, xml::Engine
+#include "xml-entities.hpp" // xml::decode_entities()
 #include "string_map.hpp" // MG::string_map<>
 
 
@@ -15,22 +25,55 @@
 namespace xml
 {
 
+//---------------------------------------------------------------------------
+// A range of the parsed buffer [start,end)
+struct ByteSpan final
+   {
+    std::size_t start = 0;
+    std::size_t end = 0;
+
+    [[nodiscard]] constexpr std::size_t size() const noexcept { return end - start; }
+    [[nodiscard]] constexpr bool operator==(const ByteSpan&) const noexcept = default;
+    [[nodiscard]] constexpr std::string_view bytes_of(const std::string_view buf) const noexcept { return buf.substr(start, size()); }
+   };
+
+
+//---------------------------------------------------------------------------
+// Where an attribute is: name and value (quotes excluded)
+struct AttributeSpan final
+   {
+    ByteSpan name;
+    std::optional<ByteSpan> value;
+   };
+
 
 /////////////////////////////////////////////////////////////////////////////
 class ParserEvent final
 {
  public:
     using Attributes = MG::string_map<std::u32string, std::optional<std::u32string>>;
+    using AttributesSpans = std::vector<AttributeSpan>;
 
  private:
     std::u32string m_value;
     std::size_t m_start_byte_offset = 0;
+    std::size_t m_end_byte_offset = 0;
+    ByteSpan m_inner_byte_span; // Close tags: content after the open tag
+    ByteSpan m_attributes_region; // Open tags: between name and '>' or '/>'
+    ByteSpan m_name_byte_span; // Tags: the name in the buffer
     Attributes m_attributes;
+    AttributesSpans m_attributes_spans; // Recorded also when attributes aren't collected
+    std::string_view m_chunk_bytes; // Text chunks: a part of the original buffer
+    bool m_last_chunk = false;
+    bool m_cdata = false; // Texts and chunks: from a CDATA section
+    std::uint32_t m_namespace_id = 0; // Tags, when namespaces are resolved
+    std::size_t m_local_name_pos = 0; // Tags: after the prefix
     enum class type : char
        {
         NONE = 0
        ,COMMENT // <!-- ... -->
        ,TEXT // >...<
+       ,TEXTCHUNK // A bounded part of a text or CDATA section
        ,OPENTAG // <tag attr1 attr2=val>
        ,CLOSETAG // </tag> or />
        ,PROCINST // <? ... ?>
@@ -42,52 +85,82 @@ class ParserEvent final
        {
         m_type = type::NONE;
         m_value = {};
-        m_attributes.clear();
+        clear_attributes();
        }
 
     constexpr void set_as_comment(std::u32string&& cmt) noexcept
        {
         m_type = type::COMMENT;
         m_value = std::move(cmt);
-        m_attributes.clear();
+        clear_attributes();
        }
     constexpr void set_as_comment() noexcept
        {
         m_type = type::COMMENT;
         m_value = {};
-        m_attributes.clear();
+        clear_attributes();
        }
 
-    constexpr void set_as_text(std::u32string&& txt) noexcept
+    constexpr void set_as_text(std::u32string&& txt, const bool cdata =false) noexcept
        {
         m_type = type::TEXT;
         m_value = std::move(txt);
-        m_attributes.clear();
+        clear_attributes();
+        m_cdata = cdata;
        }
-    constexpr void set_as_text() noexcept
+    constexpr void set_as_text(const bool cdata =false) noexcept
        {
         m_type = type::TEXT;
         m_value = {};
-        m_attributes.clear();
+        clear_attributes();
+        m_cdata = cdata;
+       }
+
+    constexpr void set_as_text_chunk(const std::string_view bytes, const bool last, const bool cdata =false) noexcept
+       {
+        m_type = type::TEXTCHUNK;
+        m_value = {};
+        clear_attributes();
+        m_chunk_bytes = bytes;
+        m_last_chunk = last;
+        m_cdata = cdata;
        }
 
     constexpr void set_as_open_tag(std::u32string&& nam)
        {
         m_type = type::OPENTAG;
         m_value = std::move(nam);
-        m_attributes.clear();
+        clear_attributes();
+        set_namespace(0, 0);
         if( m_value.empty() )
            {
             throw std::runtime_error("Empty open tag");
            }
        }
 
+    // Tags whose name is left in the buffer (see CompactEvent)
+    constexpr void set_as_open_tag() noexcept
+       {
+        m_type = type::OPENTAG;
+        m_value.clear();
+        clear_attributes();
+        set_namespace(0, 0);
+       }
+    constexpr void set_as_close_tag() noexcept
+       {
+        m_type = type::CLOSETAG;
+        m_value.clear();
+        clear_attributes();
+        set_namespace(0, 0);
+       }
+
     template<typename T>
     constexpr void set_as_close_tag(T&& nam)
        {
         m_type = type::CLOSETAG;
         m_value = std::forward<T>(nam);
-        m_attributes.clear();
+        clear_attributes();
+        set_namespace(0, 0);
         if( m_value.empty() )
            {
             throw std::runtime_error("Empty open tag");
@@ -98,27 +171,105 @@ class ParserEvent final
        {
         m_type = type::PROCINST;
         m_value = std::move(nam);
-        m_attributes.clear();
+        clear_attributes();
        }
 
     constexpr void set_as_special_block(std::u32string&& nam) noexcept
        {
         m_type = type::SPECIALBLOCK;
         m_value = std::move(nam);
-        m_attributes.clear();
+        clear_attributes();
        }
 
     [[nodiscard]] constexpr std::u32string const& value() const noexcept { return m_value; }
 
+    //-----------------------------------------------------------------------
+    // Like a new one, but the storage is retained
+    constexpr void reset() noexcept
+       {
+        m_type = type::NONE;
+        m_value.clear();
+        clear_attributes();
+        m_start_byte_offset = m_end_byte_offset = 0;
+        m_inner_byte_span = {};
+        m_name_byte_span = {};
+        m_chunk_bytes = {};
+        m_last_chunk = false;
+        m_cdata = false;
+        set_namespace(0, 0);
+       }
+
+    // Tags: the interned namespace uri (see NamespaceResolver)
+    constexpr void set_namespace(const std::uint32_t id, const std::size_t local_name_pos) noexcept { m_namespace_id = id; m_local_name_pos = local_name_pos; }
+    [[nodiscard]] constexpr std::uint32_t namespace_id() const noexcept { return m_namespace_id; }
+    [[nodiscard]] constexpr std::u32string_view local_name() const noexcept { return std::u32string_view{m_value}.substr(m_local_name_pos); }
+
+    // Text chunks: the still encoded bytes, a complete codepoints sequence
+    [[nodiscard]] constexpr std::string_view chunk_bytes() const noexcept { return m_chunk_bytes; }
+    [[nodiscard]] constexpr bool is_last_chunk() const noexcept { return m_last_chunk; }
+
+    // Texts and text chunks: the content of a CDATA section
+    [[nodiscard]] constexpr bool is_cdata() const noexcept { return m_cdata and (m_type==type::TEXT or m_type==type::TEXTCHUNK); }
+
+    // The value with the entity references resolved, in buf only if needed
+    [[nodiscard]] std::u32string_view decoded_value(std::u32string& buf) const { return decode_entities(m_value, buf); }
+
+    // Same for a collected attribute value, nothing if absent or without value
+    [[nodiscard]] std::optional<std::u32string_view> decoded_value_of(const std::u32string_view nam, std::u32string& buf) const
+       {
+        const auto it = m_attributes.find(nam);
+        if( it==m_attributes.end() or not it->second.has_value() )
+           {
+            return std::nullopt;
+           }
+        return decode_entities(*it->second, buf);
+       }
+
     constexpr void set_start_byte_offset(const std::size_t byte_offset) noexcept { m_start_byte_offset = byte_offset; }
     [[nodiscard]] constexpr std::size_t start_byte_offset() const noexcept { return m_start_byte_offset; }
+    constexpr void set_end_byte_offset(const std::size_t byte_offset) noexcept { m_end_byte_offset = byte_offset; }
+    [[nodiscard]] constexpr std::size_t end_byte_offset() const noexcept { return m_end_byte_offset; }
+    [[nodiscard]] constexpr ByteSpan byte_span() const noexcept { return {m_start_byte_offset, m_end_byte_offset}; }
+    constexpr void set_attributes_region(const ByteSpan span) noexcept { m_attributes_region = span; }
+    [[nodiscard]] constexpr ByteSpan attributes_region() const noexcept { return m_attributes_region; }
+    constexpr void set_inner_byte_span(const ByteSpan span) noexcept { m_inner_byte_span = span; }
+    [[nodiscard]] constexpr ByteSpan inner_byte_span() const noexcept { return m_inner_byte_span; }
+    constexpr void set_name_byte_span(const ByteSpan span) noexcept { m_name_byte_span = span; }
+    [[nodiscard]] constexpr ByteSpan name_byte_span() const noexcept { return m_name_byte_span; }
+
+    //-----------------------------------------------------------------------
+    // When the offsets are relative to a part of the buffer
+    constexpr void shift_byte_offsets(const std::size_t delta) noexcept
+       {
+        m_start_byte_offset += delta;
+        m_end_byte_offset += delta;
+        m_inner_byte_span.start += delta;
+        m_inner_byte_span.end += delta;
+        m_attributes_region.start += delta;
+        m_attributes_region.end += delta;
+        m_name_byte_span.start += delta;
+        m_name_byte_span.end += delta;
+        for( AttributeSpan& attr_span : m_attributes_spans )
+           {
+            attr_span.name.start += delta;
+            attr_span.name.end += delta;
+            if( attr_span.value )
+               {
+                attr_span.value->start += delta;
+                attr_span.value->end += delta;
+               }
+           }
+       }
 
     [[nodiscard]] constexpr Attributes const& attributes() const noexcept { return m_attributes; }
     [[nodiscard]] constexpr Attributes& attributes() noexcept { return m_attributes; }
+    [[nodiscard]] constexpr AttributesSpans const& attributes_spans() const noexcept { return m_attributes_spans; }
+    [[nodiscard]] constexpr AttributesSpans& attributes_spans() noexcept { return m_attributes_spans; }
 
     [[nodiscard]] constexpr operator bool() const noexcept { return m_type!=type::NONE; }
     [[nodiscard]] constexpr bool is_comment() const noexcept { return m_type==type::COMMENT; }
     [[nodiscard]] constexpr bool is_text() const noexcept { return m_type==type::TEXT; }
+    [[nodiscard]] constexpr bool is_text_chunk() const noexcept { return m_type==type::TEXTCHUNK; }
     [[nodiscard]] constexpr bool is_open_tag() const noexcept { return m_type==type::OPENTAG; }
     [[nodiscard]] constexpr bool is_close_tag() const noexcept { return m_type==type::CLOSETAG; }
     [[nodiscard]] constexpr bool is_proc_instr() const noexcept { return m_type==type::PROCINST; }
@@ -126,24 +277,490 @@ class ParserEvent final
 
     [[nodiscard]] constexpr bool is_open_tag(const std::u32string_view nam) const noexcept { return m_type==type::OPENTAG and m_value==nam; }
     [[nodiscard]] constexpr bool is_close_tag(const std::u32string_view nam) const noexcept { return m_type==type::CLOSETAG and m_value==nam; }
+    [[nodiscard]] constexpr bool is_open_tag(const std::uint32_t ns, const std::u32string_view local_nam) const noexcept { return m_type==type::OPENTAG and m_namespace_id==ns and local_name()==local_nam; }
+    [[nodiscard]] constexpr bool is_close_tag(const std::uint32_t ns, const std::u32string_view local_nam) const noexcept { return m_type==type::CLOSETAG and m_namespace_id==ns and local_name()==local_nam; }
+
+ private:
+    constexpr void clear_attributes() noexcept
+       {
+        m_attributes.clear();
+        m_attributes_spans.clear();
+        m_attributes_region = {};
+       }
 };
 
 
 
+/////////////////////////////////////////////////////////////////////////////
+// An event as spans of the buffer, given in batches (Parser::next_events()):
+// nothing is decoded until asked. The value is the name of tags and the
+// content of the others (CDATA and comments without their delimiters),
+// inner is the attributes region of open tags and the content of close
+// tags
+struct CompactEvent final
+   {
+    enum class type : std::uint8_t
+       {
+        NONE = 0
+       ,COMMENT
+       ,TEXT
+       ,TEXTCHUNK
+       ,OPENTAG
+       ,CLOSETAG
+       ,PROCINST
+       ,SPECIALBLOCK
+       } kind = type::NONE;
+    ByteSpan span; // The whole event
+    ByteSpan value;
+    ByteSpan inner;
+
+    [[nodiscard]] constexpr std::string_view value_bytes(const std::string_view bytes) const noexcept { return value.bytes_of(bytes); }
+    // Entity references not resolved, see decode_entities()
+    template<text::Enc enc>
+    [[nodiscard]] constexpr std::u32string value_of(const std::string_view bytes) const { return text::to_utf32<enc>(value.bytes_of(bytes)); }
+   };
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+// The attributes of an open tag tokenized on first access, decoding
+// just the requested values (duplicates aren't checked here)
+template<text::Enc enc>
+class LazyAttributes final
+{
+ private:
+    std::string_view m_bytes; // The whole buffer
+    ByteSpan m_region;
+    std::size_t m_line;
+    std::vector<AttributeSpan> m_spans;
+    bool m_tokenized = false;
+
+ public:
+    constexpr LazyAttributes(const std::string_view bytes, const ByteSpan region, const std::size_t line) noexcept
+      : m_bytes(bytes)
+      , m_region(region)
+      , m_line(line)
+       {}
+
+    [[nodiscard]] constexpr std::vector<AttributeSpan> const& spans() { tokenize(); return m_spans; }
+    [[nodiscard]] constexpr std::size_t size() { return spans().size(); }
+
+    //-----------------------------------------------------------------------
+    // nullptr if not found, names are compared encoded
+    [[nodiscard]] constexpr const AttributeSpan* find(const std::u32string_view nam)
+       {
+        const std::string encoded_nam = text::to<enc>(nam);
+        for( const AttributeSpan& attr_span : spans() )
+           {
+            if( attr_span.name.bytes_of(m_bytes)==encoded_nam )
+               {
+                return &attr_span;
+               }
+           }
+        return nullptr;
+       }
+
+    [[nodiscard]] constexpr bool contains(const std::u32string_view nam) { return find(nam)!=nullptr; }
+
+    //-----------------------------------------------------------------------
+    // Empty if not found or without value
+    [[nodiscard]] constexpr std::optional<std::u32string> value_of(const std::u32string_view nam)
+       {
+        if( const AttributeSpan* const attr_span = find(nam); attr_span and attr_span->value )
+           {
+            return text::to_utf32<enc>( attr_span->value->bytes_of(m_bytes) );
+           }
+        return std::nullopt;
+       }
+
+    //-----------------------------------------------------------------------
+    // The original bytes, empty if not found or without value
+    [[nodiscard]] constexpr std::optional<std::string_view> raw_value_of(const std::u32string_view nam)
+       {
+        if( const AttributeSpan* const attr_span = find(nam); attr_span and attr_span->value )
+           {
+            return attr_span->value->bytes_of(m_bytes);
+           }
+        return std::nullopt;
+       }
+
+    //-----------------------------------------------------------------------
+    // With the entity references resolved
+    [[nodiscard]] std::optional<std::u32string> decoded_value_of(const std::u32string_view nam)
+       {
+        if( const auto raw = raw_value_of(nam) )
+           {
+            std::string buf;
+            return text::to_utf32<enc>( decode_entities<enc>(*raw, buf) );
+           }
+        return std::nullopt;
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] constexpr ParserEvent::Attributes decode_all()
+       {
+        ParserEvent::Attributes attrs;
+        for( const AttributeSpan& attr_span : spans() )
+           {
+            attrs.insert_if_missing( text::to_utf32<enc>(attr_span.name.bytes_of(m_bytes)),
+                                     attr_span.value ? std::optional<std::u32string>{text::to_utf32<enc>(attr_span.value->bytes_of(m_bytes))} : std::nullopt );
+           }
+        return attrs;
+       }
+
+ private:
+    //-----------------------------------------------------------------------
+    constexpr void tokenize()
+       {
+        if( m_tokenized )
+           {
+            return;
+           }
+        m_tokenized = true;
+        // Including the stopper ('/' or '>') after the region
+        const std::size_t region_end = std::min(m_bytes.size(), m_region.end + text::code_unit_size<enc>);
+        const std::string_view region = m_bytes.substr(m_region.start, region_end - m_region.start);
+        text::ParserBase<enc> parser{region};
+        const auto span_of = [&region, this](const std::string_view sub) noexcept -> ByteSpan
+           {
+            const std::size_t start = m_region.start + static_cast<std::size_t>(sub.data() - region.data());
+            return {start, start + sub.size()};
+           };
+        try{
+            parser.skip_any_space();
+            while( parser.curr_codepoint_byte_offset()<m_region.size() )
+               {
+                AttributeSpan& attr_span = m_spans.emplace_back();
+                attr_span.name = span_of( parser.collect_bytes_until(text::is_space_or_any_of<U'=',U'>',U'/'>, text::is_punct_and_not<U'-',U':'>) );
+                if( attr_span.name.size()==0 )
+                   {
+                    throw std::runtime_error("Invalid attribute name");
+                   }
+                parser.skip_any_space();
+                if( parser.eat(U'=') )
+                   {
+                    parser.skip_any_space();
+                    attr_span.value = span_of( parser.eat(U'\"') ? parser.collect_bytes_until(text::is<U'\"'>, text::is_endline, text::flag::SKIP_STOPPER)
+                                             : parser.eat(U'\'') ? parser.collect_bytes_until(text::is<U'\''>, text::is_endline, text::flag::SKIP_STOPPER)
+                                                                 : parser.collect_bytes_until(text::is_space_or_any_of<U'>',U'/'>, text::is_any_of<U'<',U'=',U'\"'>) );
+                    parser.skip_any_space();
+                   }
+               }
+           }
+        catch( std::exception& e )
+           {
+            throw text::parse_error( fmt::format("Invalid attributes: {}"sv, e.what()), m_line );
+           }
+       }
+};
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Pairs the close tags with the open ones to set their content span
+class ContentSpanTracker final
+{
+ private:
+    std::vector<std::size_t> m_open_tags_ends;
+
+ public:
+    constexpr void reset() noexcept { m_open_tags_ends.clear(); }
+
+    constexpr void on_event(ParserEvent& event)
+       {
+        if( event.is_close_tag() )
+           {
+            std::size_t content_start = event.start_byte_offset();
+            if( not m_open_tags_ends.empty() )
+               {
+                content_start = m_open_tags_ends.back();
+                m_open_tags_ends.pop_back();
+               }
+            // The deferred close of <tag/> starts before the end of its open tag
+            event.set_inner_byte_span( {content_start, std::max(content_start, event.start_byte_offset())} );
+           }
+        else
+           {
+            if( event.is_open_tag() )
+               {
+                m_open_tags_ends.push_back( event.end_byte_offset() );
+               }
+            event.set_inner_byte_span( {event.end_byte_offset(), event.end_byte_offset()} );
+           }
+       }
+};
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Names interned as integer ids, given in order of appearance
+class NameTable final
+{
+ public:
+    using name_id_t = std::uint32_t;
+
+ private:
+    struct hash_t final
+       {
+        using is_transparent = void;
+        [[nodiscard]] std::size_t operator()(const std::u32string_view s) const noexcept { return std::hash<std::u32string_view>{}(s); }
+       };
+    std::unordered_map<std::u32string, name_id_t, hash_t, std::equal_to<>> m_ids;
+    std::vector<std::u32string> m_names; // Index is the id
+
+ public:
+    [[nodiscard]] name_id_t intern(const std::u32string_view nam)
+       {
+        if( const auto it = m_ids.find(nam); it!=m_ids.end() )
+           {
+            return it->second;
+           }
+        const auto id = static_cast<name_id_t>(m_names.size());
+        m_names.emplace_back(nam);
+        m_ids.emplace(m_names.back(), id);
+        return id;
+       }
+
+    // Without adding it
+    [[nodiscard]] std::optional<name_id_t> find(const std::u32string_view nam) const noexcept
+       {
+        if( const auto it = m_ids.find(nam); it!=m_ids.end() )
+           {
+            return it->second;
+           }
+        return std::nullopt;
+       }
+
+    [[nodiscard]] std::u32string_view name_of(const name_id_t id) const noexcept { return m_names[id]; }
+    [[nodiscard]] std::size_t size() const noexcept { return m_names.size(); }
+};
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Checks that close tags match the open ones: a stack of the spans of the
+// open tags names, compared as bytes with the close ones (so the names
+// needn't be decoded)
+template<text::Enc enc>
+class NestingChecker final
+{
+ private:
+    std::vector<ByteSpan> m_open_tags;
+
+ public:
+    [[nodiscard]] std::size_t depth() const noexcept { return m_open_tags.size(); }
+    void reset() noexcept { m_open_tags.clear(); }
+
+    void on_event(const ParserEvent& event, const std::string_view bytes)
+       {
+        if( event.is_open_tag() )
+           {
+            m_open_tags.push_back( event.name_byte_span() );
+           }
+        else if( event.is_close_tag() )
+           {
+            if( m_open_tags.empty() )
+               {
+                throw std::runtime_error( fmt::format("Unexpected close tag `{}`", name_of(event.name_byte_span(), bytes)) );
+               }
+            // The deferred close of <tag/> has the same span
+            if( m_open_tags.back()!=event.name_byte_span() and m_open_tags.back().bytes_of(bytes)!=event.name_byte_span().bytes_of(bytes) )
+               {
+                throw std::runtime_error( fmt::format("Close tag `{}` doesn't match `{}`", name_of(event.name_byte_span(), bytes), name_of(m_open_tags.back(), bytes)) );
+               }
+            m_open_tags.pop_back();
+           }
+        else if( not event and not m_open_tags.empty() )
+           {
+            throw std::runtime_error( fmt::format("Unclosed tag `{}`", name_of(m_open_tags.back(), bytes)) );
+           }
+       }
+
+ private:
+    [[nodiscard]] static std::string name_of(const ByteSpan span, const std::string_view bytes)
+       {
+        return text::to_utf8( text::to_utf32<enc>(span.bytes_of(bytes)) );
+       }
+};
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Resolves the prefixes of tags to interned namespace uris, so that
+// matching a namespaced tag is an integer compare plus its local name.
+// The declarations of an open tag must be given before its event
+// const auto ns = resolver.namespace_id(U"urn:ll"); ... event.is_open_tag(ns, U"lib")
+class NamespaceResolver final
+{
+ public:
+    using namespace_id_t = NameTable::name_id_t;
+    static constexpr namespace_id_t no_namespace = 0;
+    static constexpr namespace_id_t xml_namespace = 1;
+
+ private:
+    struct binding_t final
+       {
+        std::u32string prefix; // Empty for the default namespace
+        namespace_id_t id;
+        std::size_t depth; // Of the declaring element
+       };
+    NameTable m_uris;
+    std::vector<binding_t> m_bindings; // Innermost at the back
+    std::vector<namespace_id_t> m_elements; // Namespaces of the open elements
+    std::u32string m_cached_prefix; // Last resolution, valid until bindings change
+    namespace_id_t m_cached_id = no_namespace;
+    bool m_cache_valid = false;
+
+ public:
+    NamespaceResolver()
+       {
+        [[maybe_unused]] const auto none = m_uris.intern(U""); // no_namespace
+        [[maybe_unused]] const auto xml = m_uris.intern(U"http://www.w3.org/XML/1998/namespace"); // xml_namespace
+       }
+
+    [[nodiscard]] namespace_id_t namespace_id(const std::u32string_view uri) { return m_uris.intern(uri); }
+    [[nodiscard]] std::u32string_view uri_of(const namespace_id_t id) const noexcept { return m_uris.name_of(id); }
+
+    // Namespace ids stay valid
+    void reset() noexcept
+       {
+        m_bindings.clear();
+        m_elements.clear();
+        m_cache_valid = false;
+       }
+
+    //-----------------------------------------------------------------------
+    // An attribute of the next open tag: xmlns="uri" or xmlns:prefix="uri"
+    void declare(const std::u32string_view attr_nam, const std::u32string_view uri)
+       {
+        std::u32string_view prefix;
+        if( attr_nam.size()>6u and attr_nam[5]==U':' )
+           {
+            prefix = attr_nam.substr(6u);
+           }
+        m_bindings.push_back( {std::u32string{prefix}, m_uris.intern(uri), m_elements.size()+1u} );
+        m_cache_valid = false;
+       }
+
+    //-----------------------------------------------------------------------
+    // The xmlns attributes among the ones of the next open tag
+    template<text::Enc enc>
+    void declare_from(const std::string_view bytes, const std::span<const AttributeSpan> attributes_spans)
+       {
+        static const std::string xmlns = text::to<enc>(U"xmlns");
+        for( const AttributeSpan& attr_span : attributes_spans )
+           {
+            const std::string_view nam = attr_span.name.bytes_of(bytes);
+            if( nam.starts_with(xmlns) and (nam.size()==xmlns.size() or text::details::code_unit_at<enc>(nam.data() + xmlns.size())==U':') )
+               {
+                std::string buf;
+                declare( text::to_utf32<enc>(nam), attr_span.value ? text::to_utf32<enc>(decode_entities<enc>(attr_span.value->bytes_of(bytes), buf)) : std::u32string{} );
+               }
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    void on_event(ParserEvent& event)
+       {
+        if( event.is_open_tag() )
+           {
+            const std::size_t colon = event.value().find(U':');
+            const namespace_id_t id = resolve( colon==std::u32string::npos ? std::u32string_view{} : std::u32string_view{event.value()}.substr(0, colon) );
+            event.set_namespace(id, colon==std::u32string::npos ? 0u : colon+1u);
+            m_elements.push_back(id);
+           }
+        else if( event.is_close_tag() )
+           {
+            const std::size_t colon = event.value().find(U':');
+            if( m_elements.empty() )
+               {
+                throw std::runtime_error( fmt::format("Unexpected close tag `{}`", text::to_utf8(event.value())) );
+               }
+            event.set_namespace(m_elements.back(), colon==std::u32string::npos ? 0u : colon+1u);
+            m_elements.pop_back();
+            if( not m_bindings.empty() and m_bindings.back().depth>m_elements.size() )
+               {
+                while( not m_bindings.empty() and m_bindings.back().depth>m_elements.size() ) m_bindings.pop_back();
+                m_cache_valid = false;
+               }
+           }
+       }
+
+ private:
+    //-----------------------------------------------------------------------
+    [[nodiscard]] namespace_id_t resolve(const std::u32string_view prefix)
+       {
+        if( m_cache_valid and prefix==m_cached_prefix )
+           {
+            return m_cached_id;
+           }
+        namespace_id_t id = no_namespace;
+        const auto it = std::find_if(m_bindings.rbegin(), m_bindings.rend(), [prefix](const binding_t& b) noexcept { return b.prefix==prefix; });
+        if( it!=m_bindings.rend() )
+           {
+            id = it->id;
+           }
+        else if( prefix==U"xml" )
+           {
+            id = xml_namespace;
+           }
+        else if( not prefix.empty() )
+           {
+            throw std::runtime_error( fmt::format("Undeclared namespace prefix `{}`", text::to_utf8(prefix)) );
+           }
+        m_cached_prefix = prefix;
+        m_cached_id = id;
+        m_cache_valid = true;
+        return id;
+       }
+};
+
+
+
+//---------------------------------------------------------------------------
+// Events that can be consumed internally, never returned
+enum class SkippableEvent : std::uint8_t
+   {
+    COMMENT =1 // <!-- ... -->
+   ,TEXT =2 // Text and CDATA sections
+   ,PROCINST =4 // <? ... ?>
+   ,SPECIALBLOCK =8 // <!xxx ... !>
+   };
+
+
 /////////////////////////////////////////////////////////////////////////////
 template<text::Enc enc>
 class Parser final
 {
  private:
+    std::string_view m_bytes;
     text::ParserBase<enc> m_parser;
+    StructuralIndex<enc> m_index; // Built only for Engine::STRUCTURAL_INDEX
+    Engine m_engine = Engine::CODEPOINT;
     ParserEvent m_event; // Current event
     bool m_must_emit_tag_close_event = false; // To signal a deferred tag close
+    ContentSpanTracker m_content_spans;
+    NestingChecker<enc> m_nesting; // Used if Options::is_check_nesting()
+    NamespaceResolver m_namespaces; // Used if Options::is_resolve_namespaces()
+    std::string_view m_pending_text; // Text chunks still to emit
+    bool m_has_pending_text = false; // Also for empty sections
+    bool m_pending_cdata = false; // The pending text is a CDATA section
+    bool m_event_skipped = false; // The last parsed event mustn't be returned
+    static constexpr std::size_t unit_size = text::code_unit_size<enc>;
 
+ public:
     class Options final
        {
         private:
             bool m_collect_comment_text = false; // Create event on comments
             bool m_collect_text_sections = false; // Collect text events content
+            bool m_collect_attributes = true; // Collect the attributes of open tags
+            bool m_lazy_attributes = false; // Just record the attributes region
+            bool m_decode_tag_names = true; // Tag events have their name, not just its span
+            std::size_t m_text_chunk_bytes = 0; // If not zero emit text sections in chunks
+            bool m_check_nesting = false; // Close tags must match the open ones
+            bool m_resolve_namespaces = false; // Tags get the id of their namespace
+            std::uint8_t m_skipped_events = 0; // Mask of SkippableEvent
 
         public:
             [[nodiscard]] constexpr bool is_collect_comment_text() const noexcept { return m_collect_comment_text; }
@@ -152,47 +769,206 @@ class Parser final
             [[nodiscard]] constexpr bool is_collect_text_sections() const noexcept { return m_collect_text_sections; }
             constexpr void set_collect_text_sections(const bool b =true) noexcept { m_collect_text_sections = b; }
 
-       } m_Options;
+            [[nodiscard]] constexpr bool is_collect_attributes() const noexcept { return m_collect_attributes; }
+            constexpr void set_collect_attributes(const bool b =true) noexcept { m_collect_attributes = b; }
+
+            [[nodiscard]] constexpr bool is_lazy_attributes() const noexcept { return m_lazy_attributes; }
+            constexpr void set_lazy_attributes(const bool b =true) noexcept { m_lazy_attributes = b; }
+
+            // Names are decoded anyway when resolving the namespaces
+            [[nodiscard]] constexpr bool is_decode_tag_names() const noexcept { return m_decode_tag_names; }
+            constexpr void set_decode_tag_names(const bool b =true) noexcept { m_decode_tag_names = b; }
+
+            // Text and CDATA sections as consecutive text chunks of at most
+            // this size (at least a codepoint), zero to disable
+            [[nodiscard]] constexpr std::size_t text_chunk_bytes() const noexcept { return m_text_chunk_bytes; }
+            constexpr void set_text_chunk_bytes(const std::size_t n) noexcept { m_text_chunk_bytes = n; }
+
+            [[nodiscard]] constexpr bool is_check_nesting() const noexcept { return m_check_nesting; }
+            constexpr void set_check_nesting(const bool b =true) noexcept { m_check_nesting = b; }
+
+            [[nodiscard]] constexpr bool is_resolve_namespaces() const noexcept { return m_resolve_namespaces; }
+            constexpr void set_resolve_namespaces(const bool b =true) noexcept { m_resolve_namespaces = b; }
+
+            // Skipped events are just scanned for their termination
+            [[nodiscard]] constexpr bool is_skip(const SkippableEvent ev) const noexcept { return (m_skipped_events & std::to_underlying(ev))!=0; }
+            constexpr void set_skip(const SkippableEvent ev, const bool b =true) noexcept
+               {
+                if( b ) m_skipped_events = static_cast<std::uint8_t>(m_skipped_events | std::to_underlying(ev));
+                else m_skipped_events = static_cast<std::uint8_t>(m_skipped_events & ~std::to_underlying(ev));
+               }
+       };
+
+ private:
+    Options m_Options;
 
  public:
     explicit constexpr Parser(const std::string_view bytes) noexcept
-      : m_parser(bytes)
+      : m_bytes(bytes)
+      , m_parser(bytes)
        {}
 
+    explicit Parser(const std::string_view bytes, const Engine engine)
+      : m_bytes(bytes)
+      , m_parser(bytes)
+      , m_engine(engine)
+       {
+        if( m_engine==Engine::STRUCTURAL_INDEX )
+           {
+            m_index.build(bytes);
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    // Parse another buffer with the same options and engine, retaining the
+    // allocated storage (event strings, index, name tables), namespace
+    // ids stay valid
+    void reset(const std::string_view bytes)
+       {
+        m_bytes = bytes;
+        m_parser.reset(bytes);
+        if( m_engine==Engine::STRUCTURAL_INDEX )
+           {
+            m_index.build(bytes);
+           }
+        m_event.reset();
+        m_must_emit_tag_close_event = false;
+        m_content_spans.reset();
+        m_nesting.reset();
+        m_namespaces.reset();
+        m_pending_text = {};
+        m_has_pending_text = false;
+        m_pending_cdata = false;
+        m_event_skipped = false;
+       }
+
+    [[nodiscard]] constexpr Engine engine() const noexcept { return m_engine; }
+
     [[nodiscard]] constexpr Options const& options() const noexcept { return m_Options; }
     [[nodiscard]] constexpr Options& options() noexcept { return m_Options; }
 
     [[nodiscard]] constexpr ParserEvent const& curr_event() const noexcept { return m_event; }
     [[nodiscard]] constexpr ParserEvent& mutable_curr_event() noexcept { return m_event; }
+    [[nodiscard]] constexpr std::string_view bytes() const noexcept { return m_bytes; } // The event spans refer to
 
     constexpr void set_on_notify_issue(const text::ParserBase<enc>::fnotify_t& f) { m_parser.set_on_notify_issue(f); }
     [[nodiscard]] constexpr std::size_t curr_line() const noexcept { return m_parser.curr_line(); }
 
+    // Attributes of the current open tag tokenized on demand
+    [[nodiscard]] constexpr LazyAttributes<enc> lazy_attributes() const noexcept { return LazyAttributes<enc>{m_bytes, m_event.attributes_region(), curr_line()}; }
+
+    // The id to compare with ParserEvent::namespace_id()
+    [[nodiscard]] NamespaceResolver::namespace_id_t namespace_id(const std::u32string_view uri) { return m_namespaces.namespace_id(uri); }
+
     [[nodiscard]] constexpr ParserEvent const& next_event()
+       {
+        try{
+            parse_next_event();
+           }
+        catch(text::parse_error&)
+           {
+            throw;
+           }
+        catch(std::runtime_error& e)
+           {
+            throw m_parser.create_parse_error(e.what());
+           }
+        return m_event;
+       }
+
+    //-----------------------------------------------------------------------
+    // Fill the given slots with the next events, returns how many: less
+    // than the slots only at the end. Tag names, texts and attributes
+    // aren't decoded (names are just when resolving the namespaces), so
+    // in the meanwhile curr_event() has just the type and spans
+    // std::array<xml::CompactEvent,256> events;
+    // while( const std::size_t n = parser.next_events(events) ) ...
+    [[nodiscard]] std::size_t next_events(const std::span<CompactEvent> events)
+       {
+        const Options options = m_Options;
+        const auto restore_options = [this, &options]() noexcept
+           {
+            m_Options = options;
+           };
+        m_Options.set_collect_comment_text(false);
+        m_Options.set_collect_text_sections(false);
+        m_Options.set_lazy_attributes(true);
+        m_Options.set_decode_tag_names(false);
+
+        std::size_t n = 0;
+        try{
+            while( n<events.size() )
+               {
+                parse_next_event();
+                if( not m_event )
+                   {
+                    break;
+                   }
+                events[n] = compact_event();
+                ++n;
+               }
+           }
+        catch(text::parse_error&)
+           {
+            restore_options();
+            throw;
+           }
+        catch(std::runtime_error& e)
+           {
+            restore_options();
+            throw m_parser.create_parse_error(e.what());
+           }
+        restore_options();
+        return n;
+       }
+
+ private:
+    //-----------------------------------------------------------------------
+    constexpr void parse_next_event()
        {
         if( m_must_emit_tag_close_event )
            {
             m_must_emit_tag_close_event = false; // eat
-            m_event.set_as_close_tag( m_event.value() );
+            if( is_decoding_tag_names() )
+               {
+                m_event.set_as_close_tag( text::to_utf32<enc>(m_event.name_byte_span().bytes_of(m_bytes)) );
+               }
+            else
+               {
+                m_event.set_as_close_tag();
+               }
+           }
+        else if( m_has_pending_text )
+           {
+            next_text_chunk();
            }
         else
            {
-            try{
+            do {
+                m_event_skipped = false;
                 m_parser.skip_any_space();
-                m_event.set_start_byte_offset( m_parser.curr_byte_offset() );
+                m_event.set_start_byte_offset( m_parser.curr_codepoint_byte_offset() );
                 if( m_parser.has_codepoint() )
                    {
                     if( m_parser.eat(U'<') )
                        {
                         parse_xml_markup();
                        }
+                    else if( options().is_skip(SkippableEvent::TEXT) )
+                       {
+                        skip_text();
+                       }
+                    else if( options().text_chunk_bytes()>0 )
+                       {
+                        start_text_chunks( collect_text_bytes() );
+                       }
                     else if( options().is_collect_text_sections() )
                        {
-                        m_event.set_as_text( m_parser.collect_until(text::is<U'<'>, text::is_always_false) );
+                        m_event.set_as_text( text::to_utf32<enc>(collect_text_bytes()) );
                        }
                     else
                        {
-                        [[maybe_unused]] const auto text = m_parser.collect_bytes_until(text::is<U'<'>, text::is_always_false);
+                        [[maybe_unused]] const auto text = collect_text_bytes();
                         m_event.set_as_text();
                        }
                    }
@@ -201,21 +977,46 @@ class Parser final
                     m_event.set_as_none();
                    }
                }
-            catch(text::parse_error&)
+            while( m_event_skipped );
+
+            if( m_has_pending_text )
                {
-                throw;
+                next_text_chunk();
                }
-            catch(std::runtime_error& e)
+            else
                {
-                throw m_parser.create_parse_error(e.what());
+                m_event.set_end_byte_offset( m_parser.curr_codepoint_byte_offset() );
                }
            }
-
-        return m_event;
+        m_content_spans.on_event(m_event);
+        if( options().is_check_nesting() )
+           {
+            m_nesting.on_event(m_event, m_bytes);
+           }
+        if( options().is_resolve_namespaces() )
+           {
+            resolve_namespaces();
+           }
        }
 
+    //-----------------------------------------------------------------------
+    void resolve_namespaces()
+       {
+        if( m_event.is_open_tag() )
+           {
+            if( options().is_lazy_attributes() )
+               {
+                auto attrs = lazy_attributes();
+                m_namespaces.template declare_from<enc>(m_bytes, attrs.spans());
+               }
+            else
+               {
+                m_namespaces.template declare_from<enc>(m_bytes, m_event.attributes_spans());
+               }
+           }
+        m_namespaces.on_event(m_event);
+       }
 
- private:
     //-----------------------------------------------------------------------
     constexpr void parse_xml_markup()
        {
@@ -223,13 +1024,17 @@ class Parser final
            {
             if( m_parser.eat(U"--") )
                {// A comment ex. <!-- ... -->
-                if( options().is_collect_comment_text() )
+                if( options().is_skip(SkippableEvent::COMMENT) )
+                   {
+                    skip_past<U'-',U'-',U'>'>();
+                   }
+                else if( options().is_collect_comment_text() )
                    {
-                    m_event.set_as_comment( m_parser.template collect_until<U'-',U'-',U'>'>() );
+                    m_event.set_as_comment( text::to_utf32<enc>(collect_bytes_until<U'-',U'-',U'>'>()) );
                    }
                 else
                    {
-                    [[maybe_unused]] const auto text = m_parser.template collect_bytes_until<U'-',U'-',U'>'>();
+                    [[maybe_unused]] const auto text = collect_bytes_until<U'-',U'-',U'>'>();
                     m_event.set_as_comment();
                    }
                }
@@ -237,14 +1042,22 @@ class Parser final
                {
                 if( m_parser.eat(U"CDATA[") )
                    {// A CDATA section <![CDATA[ ... ]]>
-                    if( options().is_collect_text_sections() )
+                    if( options().is_skip(SkippableEvent::TEXT) )
                        {
-                        m_event.set_as_text( m_parser.template collect_until<U']',U']',U'>'>() );
+                        skip_past<U']',U']',U'>'>();
+                       }
+                    else if( options().text_chunk_bytes()>0 )
+                       {
+                        start_text_chunks( collect_bytes_until<U']',U']',U'>'>(), true );
+                       }
+                    else if( options().is_collect_text_sections() )
+                       {
+                        m_event.set_as_text( text::to_utf32<enc>(collect_bytes_until<U']',U']',U'>'>()), true );
                        }
                     else
                        {
-                        [[maybe_unused]] const auto text = m_parser.template collect_bytes_until<U']',U']',U'>'>();
-                        m_event.set_as_text();
+                        [[maybe_unused]] const auto text = collect_bytes_until<U']',U']',U'>'>();
+                        m_event.set_as_text(true);
                        }
                    }
                 else
@@ -256,88 +1069,359 @@ class Parser final
                {
                 throw std::runtime_error("Unclosed <!");
                }
+            else if( options().is_skip(SkippableEvent::SPECIALBLOCK) )
+               {
+                skip_past<U'>'>();
+               }
             else
                {// A special block: ex. <!DOCTYPE HTML>
-                m_event.set_as_special_block( m_parser.template collect_until<U'>'>() );
+                m_event.set_as_special_block( text::to_utf32<enc>(collect_bytes_until<U'>'>()) );
                 //m_event.set_as_special_block( m_parser.collect_until(U"]>") );
                }
            }
         else if( m_parser.eat(U'?') )
            {// A processing instruction ex. <?xml version="1.0" encoding="utf-8"?>
-            //m_event.set_as_proc_instr( m_parser.collect_until(U"?>") );
-            [[maybe_unused]] const auto text = m_parser.template collect_bytes_until<U'?',U'>'>();
-            m_event.set_as_proc_instr(U""s);
+            if( options().is_skip(SkippableEvent::PROCINST) )
+               {
+                skip_past<U'?',U'>'>();
+               }
+            else
+               {
+                //m_event.set_as_proc_instr( m_parser.collect_until(U"?>") );
+                [[maybe_unused]] const auto text = collect_bytes_until<U'?',U'>'>();
+                m_event.set_as_proc_instr(U""s);
+               }
+           }
+        else if( m_parser.eat(U'/') )
+           {// A close tag
+            set_tag_event(false, collect_tag_name_bytes());
+            m_parser.skip_any_space();
+            if( not m_parser.eat(U'>') )
+               {
+                throw std::runtime_error("Invalid close tag");
+               }
+           }
+        else
+           {// A tag
+            set_tag_event(true, collect_tag_name_bytes());
+            m_parser.skip_any_space();
+            const std::size_t attributes_start = m_parser.curr_codepoint_byte_offset();
+            if( options().is_lazy_attributes() )
+               {// Just find the tag end
+                const std::size_t tag_end = find_tag_end();
+                std::size_t attributes_end = tag_end;
+                if( tag_end>attributes_start and text::details::code_unit_at<enc>(m_bytes.data() + tag_end - unit_size)==U'/' )
+                   {// Next event will be a tag close
+                    attributes_end -= unit_size;
+                    m_must_emit_tag_close_event = true;
+                   }
+                m_event.set_attributes_region( {attributes_start, attributes_end} );
+                [[maybe_unused]] const bool closed = m_parser.eat(U'>');
+               }
+            else if( m_parser.eat(U'>') )
+               {
+                m_event.set_attributes_region( {attributes_start, attributes_start} );
+               }
+            else
+               {
+                if( options().is_collect_attributes() )
+                   {
+                    auto namval = collect_attribute();
+                    while( not namval.first.empty() )
+                       {
+                        if( m_event.attributes().contains(namval.first) )
+                           {
+                            throw m_parser.create_parse_error( fmt::format("Duplicated attribute `{}`", text::to_utf8(namval.first)) );
+                           }
+                        m_event.attributes().append( std::move(namval) );
+                        namval = collect_attribute();
+                       }
+                   }
+                else
+                   {
+                    while( skip_attribute() ) ;
+                   }
+                m_event.set_attributes_region( {attributes_start, m_parser.curr_codepoint_byte_offset()} );
+
+                // Detect immediate tag close
+                if( m_parser.eat(U'/') )
+                   {// Next event will be a tag close
+                    m_must_emit_tag_close_event = true;
+                    //m_parser.skip_any_space();
+                   }
+
+                // Expect >
+                if( not m_parser.eat(U'>') )
+                   {
+                    throw m_parser.create_parse_error( fmt::format("Tag `{}` must be closed with >", tag_name_utf8()) );
+                   }
+               }
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    constexpr void start_text_chunks(const std::string_view bytes, const bool cdata =false) noexcept
+       {
+        m_pending_text = bytes;
+        m_has_pending_text = true;
+        m_pending_cdata = cdata;
+       }
+
+    //-----------------------------------------------------------------------
+    // Emit the next part of the pending text section, the parser has
+    // already moved after the whole section
+    constexpr void next_text_chunk() noexcept
+       {
+        const std::size_t len = text_chunk_size(m_pending_text, options().text_chunk_bytes());
+        const std::string_view chunk = m_pending_text.substr(0, len);
+        m_pending_text.remove_prefix(len);
+        m_has_pending_text = not m_pending_text.empty();
+        m_event.set_as_text_chunk(chunk, not m_has_pending_text, m_pending_cdata);
+        const auto start = static_cast<std::size_t>(chunk.data() - m_bytes.data());
+        m_event.set_start_byte_offset(start);
+        m_event.set_end_byte_offset(start + len);
+       }
+
+    //-----------------------------------------------------------------------
+    // The bytes of a chunk not exceeding max_bytes without splitting a
+    // codepoint, grown to the first one if it doesn't fit
+    [[nodiscard]] static constexpr std::size_t text_chunk_size(const std::string_view bytes, const std::size_t max_bytes) noexcept
+       {
+        std::size_t len = std::min(bytes.size(), max_bytes) / unit_size * unit_size;
+        const auto is_continuation = [bytes](const std::size_t pos) noexcept -> bool
+           {
+            const char32_t cu = text::details::code_unit_at<enc>(bytes.data() + pos);
+            if constexpr( unit_size==1u ) return (cu & 0xC0u)==0x80u;
+            else if constexpr( unit_size==2u ) return cu>=0xDC00u and cu<=0xDFFFu; // Low surrogate
+            else return false;
+           };
+        while( len>0 and len<bytes.size() and is_continuation(len) ) len -= unit_size;
+        if( len==0 and not bytes.empty() )
+           {
+            len = unit_size;
+            while( len<bytes.size() and is_continuation(len) ) len += unit_size;
+           }
+        return len;
+       }
+
+    //-----------------------------------------------------------------------
+    // Lazy attributes: move to the '>' that closes the tag skipping the
+    // quoted values, a single scan without tokenizing
+    [[nodiscard]] constexpr std::size_t find_tag_end()
+       {
+        if( m_engine==Engine::STRUCTURAL_INDEX )
+           {
+            std::size_t pos = m_parser.curr_codepoint_byte_offset();
+            while( true )
+               {
+                const std::size_t gt = m_index.template find_next<U'>'>(pos);
+                if( gt==StructuralIndex<enc>::npos )
+                   {
+                    throw std::runtime_error( fmt::format("Tag `{}` must be closed with >", tag_name_utf8()) );
+                   }
+                const std::size_t dquote = m_index.template find_next<U'\"'>(pos);
+                const std::size_t squote = m_index.template find_next<U'\''>(pos);
+                const std::size_t quote = std::min(dquote, squote);
+                if( quote>gt ) // Also npos
+                   {
+                    jump_to(gt);
+                    return gt;
+                   }
+                const std::size_t closing_quote = quote==dquote ? m_index.template find_next<U'\"'>(quote + unit_size)
+                                                                : m_index.template find_next<U'\''>(quote + unit_size);
+                if( closing_quote==StructuralIndex<enc>::npos )
+                   {
+                    throw std::runtime_error("Unclosed quote");
+                   }
+                pos = closing_quote + unit_size;
+               }
+           }
+        while( not m_parser.got(U'>') )
+           {
+            if( m_parser.eat(U'\"') )
+               {
+                [[maybe_unused]] const auto val = collect_quoted_attr_value_bytes<U'\"'>();
+               }
+            else if( m_parser.eat(U'\'') )
+               {
+                [[maybe_unused]] const auto val = collect_quoted_attr_value_bytes<U'\''>();
+               }
+            else if( not m_parser.get_next() )
+               {
+                throw std::runtime_error( fmt::format("Tag `{}` must be closed with >", tag_name_utf8()) );
+               }
+           }
+        return m_parser.curr_codepoint_byte_offset();
+       }
+
+    //-----------------------------------------------------------------------
+    // Move the codepoint parser to a position found in the structural index
+    constexpr void jump_to(const std::size_t byte_pos)
+       {
+        m_parser.advance_to_byte_offset(byte_pos, m_index.count_endlines(m_parser.curr_codepoint_byte_offset(), byte_pos));
+       }
+
+    //-----------------------------------------------------------------------
+    // Same without an index, line ends counted with a vectorized scan
+    constexpr void scan_to(const std::size_t byte_pos)
+       {
+        const std::size_t from = m_parser.curr_codepoint_byte_offset();
+        m_parser.advance_to_byte_offset(byte_pos, text::count_any_of<enc,U'\n'>(m_bytes.substr(from, byte_pos-from)));
+       }
+
+    //-----------------------------------------------------------------------
+    // A suppressed text section, until next tag
+    constexpr void skip_text()
+       {
+        m_event_skipped = true;
+        if( m_engine==Engine::STRUCTURAL_INDEX )
+           {
+            [[maybe_unused]] const auto text = collect_text_bytes();
+            return;
+           }
+        const std::size_t end = text::find_any_of<enc,U'<'>(m_bytes, m_parser.curr_codepoint_byte_offset());
+        if( end==std::string_view::npos )
+           {
+            throw m_parser.create_parse_error("Unexpected end (termination not found)"s);
+           }
+        scan_to(end);
+       }
+
+    //-----------------------------------------------------------------------
+    // A suppressed block: jumps after its termination sequence searching
+    // its first codepoint in blocks
+    template<char32_t first, char32_t... rest>
+    constexpr void skip_past()
+       {
+        m_event_skipped = true;
+        if( m_engine==Engine::STRUCTURAL_INDEX )
+           {
+            [[maybe_unused]] const auto text = collect_bytes_until<first,rest...>();
+            return;
            }
-        else if( m_parser.eat(U'/') )
-           {// A close tag
-            m_event.set_as_close_tag( collect_tag_name() );
-            m_parser.skip_any_space();
-            if( not m_parser.eat(U'>') )
+        constexpr std::size_t seq_bytes = (1u + sizeof...(rest)) * unit_size;
+        const auto rest_matches = [this](const std::size_t pos) noexcept -> bool
+           {
+            if( m_bytes.size()-pos < seq_bytes ) return false;
+            [[maybe_unused]] std::size_t i = pos;
+            return ((text::details::code_unit_at<enc>(m_bytes.data() + (i+=unit_size))==rest) and ...);
+           };
+        std::size_t pos = m_parser.curr_codepoint_byte_offset();
+        while( (pos = text::find_any_of<enc,first>(m_bytes, pos))!=std::string_view::npos )
+           {
+            if( rest_matches(pos) )
                {
-                throw std::runtime_error("Invalid close tag");
+                scan_to(pos + seq_bytes);
+                return;
                }
+            pos += unit_size;
            }
-        else
-           {// A tag
-            m_event.set_as_open_tag( collect_tag_name() );
-            m_parser.skip_any_space();
-            if( !m_parser.eat(U'>') )
-               {
-                // Collect attributes
-                auto namval = collect_attribute();
-                while( not namval.first.empty() )
-                   {
-                    if( m_event.attributes().contains(namval.first) )
-                       {
-                        throw m_parser.create_parse_error( fmt::format("Duplicated attribute `{}`", text::to_utf8(namval.first)) );
-                       }
-                    m_event.attributes().append( std::move(namval) );
-                    namval = collect_attribute();
-                   }
+        throw m_parser.create_parse_error( fmt::format("Should be closed by {}"sv, text::to_utf8(std::u32string{first, rest...})) );
+       }
 
-                // Detect immediate tag close
-                if( m_parser.eat(U'/') )
-                   {// Next event will be a tag close
-                    m_must_emit_tag_close_event = true;
-                    //m_parser.skip_any_space();
-                   }
+    //-----------------------------------------------------------------------
+    // Text content, until next tag
+    [[nodiscard]] constexpr std::string_view collect_text_bytes()
+       {
+        if( m_engine==Engine::STRUCTURAL_INDEX )
+           {
+            const std::size_t start = m_parser.curr_codepoint_byte_offset();
+            const std::size_t end = m_index.template find_next<U'<'>(start);
+            if( end==StructuralIndex<enc>::npos )
+               {
+                throw m_parser.create_parse_error("Unexpected end (termination not found)"s);
+               }
+            jump_to(end);
+            return m_index.bytes().substr(start, end-start);
+           }
+        return m_parser.collect_bytes_until(text::is<U'<'>, text::is_always_false);
+       }
 
-                // Expect >
-                if( not m_parser.eat(U'>') )
-                   {
-                    throw m_parser.create_parse_error( fmt::format("Tag `{}` must be closed with >", text::to_utf8(m_event.value())) );
-                   }
+    //-----------------------------------------------------------------------
+    // Content of a block, skipping its termination sequence
+    template<char32_t... end_seq>
+    [[nodiscard]] constexpr std::string_view collect_bytes_until()
+       {
+        if( m_engine==Engine::STRUCTURAL_INDEX )
+           {
+            const std::size_t start = m_parser.curr_codepoint_byte_offset();
+            const std::size_t end = m_index.template find_sequence<end_seq...>(start);
+            if( end==StructuralIndex<enc>::npos )
+               {
+                throw m_parser.create_parse_error( fmt::format("Should be closed by {}"sv, text::to_utf8(std::u32string{end_seq...})) );
                }
+            jump_to(end + sizeof...(end_seq)*StructuralIndex<enc>::unit_size);
+            return m_index.bytes().substr(start, end-start);
            }
+        return m_parser.template collect_bytes_until<end_seq...>();
        }
 
     //-----------------------------------------------------------------------
     [[nodiscard]] constexpr ParserEvent::Attributes::item_type collect_attribute()
        {
-        assert( not m_parser.got_space() ); // collect_attribute() expects non-space char
         ParserEvent::Attributes::item_type namval;
+        const auto [nam, val] = collect_attribute_bytes();
+        namval.first = text::to_utf32<enc>(nam);
+        if( val )
+           {
+            namval.second = text::to_utf32<enc>(*val);
+           }
+        return namval;
+       }
+
+    //-----------------------------------------------------------------------
+    // Same as collect_attribute() without decoding, false if none
+    [[nodiscard]] constexpr bool skip_attribute()
+       {
+        return not collect_attribute_bytes().first.empty();
+       }
 
-        namval.first = collect_attr_name();
+    //-----------------------------------------------------------------------
+    // Name and possible value of an attribute, recording their spans
+    [[nodiscard]] constexpr std::pair<std::string_view,std::optional<std::string_view>> collect_attribute_bytes()
+       {
+        assert( not m_parser.got_space() ); // collect_attribute_bytes() expects non-space char
+        std::pair<std::string_view,std::optional<std::string_view>> namval;
+        namval.first = collect_attr_name_bytes();
         if( not namval.first.empty() )
            {// Check possible value
-            m_parser.skip_any_space();
-            if( m_parser.eat(U'=') )
-               {
-                m_parser.skip_any_space();
-                namval.second = m_parser.eat(U'\"') ? collect_quoted_attr_value()
-                                                    : collect_unquoted_attr_value();
-                m_parser.skip_any_space();
-               }
+            namval.second = collect_attr_value_bytes();
+            m_event.attributes_spans().push_back( {span_of(namval.first), namval.second ? std::optional<ByteSpan>{span_of(*namval.second)} : std::nullopt} );
            }
         return namval;
        }
 
     //-----------------------------------------------------------------------
-    [[nodiscard]] constexpr std::u32string collect_tag_name()
+    // The span of a view of the buffer
+    [[nodiscard]] constexpr ByteSpan span_of(const std::string_view sub) const noexcept
+       {
+        const std::size_t start = static_cast<std::size_t>(sub.data() - m_bytes.data());
+        return {start, start + sub.size()};
+       }
+
+    //-----------------------------------------------------------------------
+    // The possible value after an attribute name
+    [[nodiscard]] constexpr std::optional<std::string_view> collect_attr_value_bytes()
+       {
+        std::optional<std::string_view> val;
+        m_parser.skip_any_space();
+        if( m_parser.eat(U'=') )
+           {
+            m_parser.skip_any_space();
+            val = m_parser.eat(U'\"') ? collect_quoted_attr_value_bytes<U'\"'>()
+                : m_parser.eat(U'\'') ? collect_quoted_attr_value_bytes<U'\''>()
+                                      : collect_unquoted_attr_value_bytes();
+            m_parser.skip_any_space();
+           }
+        return val;
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] constexpr std::string_view collect_tag_name_bytes()
        {
         m_parser.skip_any_space();
         try{
-            return m_parser.collect_until(text::is_space_or_any_of<U'>',U'/'>, text::is_punct_and_not<U'-',U':'>);
+            return m_parser.collect_bytes_until(text::is_space_or_any_of<U'>',U'/'>, text::is_punct_and_not<U'-',U':'>);
            }
         catch(std::exception& e)
            {
@@ -346,11 +1430,93 @@ class Parser final
        }
 
     //-----------------------------------------------------------------------
-    [[nodiscard]] constexpr std::u32string collect_attr_name()
+    [[nodiscard]] constexpr bool is_decoding_tag_names() const noexcept
+       {
+        return m_Options.is_decode_tag_names() or m_Options.is_resolve_namespaces();
+       }
+
+    //-----------------------------------------------------------------------
+    // The name is decoded just if needed
+    constexpr void set_tag_event(const bool is_open, const std::string_view name_bytes)
+       {
+        m_event.set_name_byte_span( span_of(name_bytes) );
+        if( is_decoding_tag_names() )
+           {
+            if( is_open ) m_event.set_as_open_tag( text::to_utf32<enc>(name_bytes) );
+            else m_event.set_as_close_tag( text::to_utf32<enc>(name_bytes) );
+           }
+        else if( name_bytes.empty() )
+           {
+            throw std::runtime_error("Empty tag");
+           }
+        else if( is_open ) m_event.set_as_open_tag();
+        else m_event.set_as_close_tag();
+       }
+
+    //-----------------------------------------------------------------------
+    // For the messages, also when the names aren't decoded
+    [[nodiscard]] std::string tag_name_utf8() const
+       {
+        return text::to_utf8( text::to_utf32<enc>(m_event.name_byte_span().bytes_of(m_bytes)) );
+       }
+
+    //-----------------------------------------------------------------------
+    // The current event as spans
+    [[nodiscard]] constexpr CompactEvent compact_event() const noexcept
+       {
+        using enum CompactEvent::type;
+        CompactEvent ev;
+        ev.span = m_event.byte_span();
+        ev.value = ev.span;
+        const auto strip = [&ev](const std::size_t head_units, const std::size_t tail_units) noexcept
+           {
+            ev.value = {ev.span.start + head_units*unit_size, ev.span.end - tail_units*unit_size};
+           };
+        if( m_event.is_open_tag() )
+           {
+            ev.kind = OPENTAG;
+            ev.value = m_event.name_byte_span();
+            ev.inner = m_event.attributes_region();
+           }
+        else if( m_event.is_close_tag() )
+           {
+            ev.kind = CLOSETAG;
+            ev.value = m_event.name_byte_span();
+            ev.inner = m_event.inner_byte_span();
+           }
+        else if( m_event.is_text_chunk() )
+           {
+            ev.kind = TEXTCHUNK;
+           }
+        else if( m_event.is_text() )
+           {
+            ev.kind = TEXT;
+            if( text::details::code_unit_at<enc>(m_bytes.data() + ev.span.start)==U'<' ) strip(9u, 3u); // <![CDATA[ ]]>
+           }
+        else if( m_event.is_comment() )
+           {
+            ev.kind = COMMENT;
+            strip(4u, 3u); // <!-- -->
+           }
+        else if( m_event.is_proc_instr() )
+           {
+            ev.kind = PROCINST;
+            strip(2u, 2u); // <? ?>
+           }
+        else if( m_event.is_special_block() )
+           {
+            ev.kind = SPECIALBLOCK;
+            strip(2u, 1u); // <! >
+           }
+        return ev;
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] constexpr std::string_view collect_attr_name_bytes()
        {
-        assert( not m_parser.got_space() ); // collect_unquoted_attr_name() expects non-space char"
+        assert( not m_parser.got_space() ); // collect_attr_name_bytes() expects non-space char"
         try{
-            return m_parser.collect_until(text::is_space_or_any_of<U'=',U'>',U'/'>, text::is_punct_and_not<U'-'>);
+            return m_parser.collect_bytes_until(text::is_space_or_any_of<U'=',U'>',U'/'>, text::is_punct_and_not<U'-',U':'>);
            }
         catch(std::exception& e)
            {
@@ -359,10 +1525,22 @@ class Parser final
        }
 
     //-----------------------------------------------------------------------
-    [[nodiscard]] constexpr std::u32string collect_quoted_attr_value()
+    template<char32_t quote>
+    [[nodiscard]] constexpr std::string_view collect_quoted_attr_value_bytes()
        {
         try{
-            return m_parser.collect_until(text::is<U'\"'>, text::is_endline, text::flag::SKIP_STOPPER);
+            if( m_engine==Engine::STRUCTURAL_INDEX )
+               {
+                const std::size_t start = m_parser.curr_codepoint_byte_offset();
+                const std::size_t end = m_index.template find_next<quote>(start);
+                if( end==StructuralIndex<enc>::npos or m_index.count_endlines(start, end)>0 )
+                   {
+                    throw std::runtime_error("Unclosed quote in line");
+                   }
+                jump_to(end + StructuralIndex<enc>::unit_size); // Skip the closing quote
+                return m_index.bytes().substr(start, end-start);
+               }
+            return m_parser.collect_bytes_until(text::is<quote>, text::is_endline, text::flag::SKIP_STOPPER);
            }
         catch(std::exception& e)
            {
@@ -371,11 +1549,11 @@ class Parser final
        }
 
     //-----------------------------------------------------------------------
-    [[nodiscard]] constexpr std::u32string collect_unquoted_attr_value()
+    [[nodiscard]] constexpr std::string_view collect_unquoted_attr_value_bytes()
        {
-        assert( not m_parser.got_space() ); // collect_unquoted_attr_value() expects non-space char"
+        assert( not m_parser.got_space() ); // collect_unquoted_attr_value_bytes() expects non-space char"
         try{
-            return m_parser.collect_until(text::is_space_or_any_of<U'>',U'/'>, text::is_any_of<U'<',U'=',U'\"'>);
+            return m_parser.collect_bytes_until(text::is_space_or_any_of<U'>',U'/'>, text::is_any_of<U'<',U'=',U'\"'>);
            }
         catch(std::exception& e)
            {
@@ -385,6 +1563,109 @@ class Parser final
 };
 
 
+
+    namespace details
+       {
+        template<typename H> concept has_on_open_tag = requires(H& h, const std::u32string_view nam) { h.on_open_tag(nam); };
+        template<typename H> concept has_on_attribute = requires(H& h, const std::u32string_view nam, const std::optional<std::u32string_view> val) { h.on_attribute(nam, val); };
+        template<typename H> concept has_on_close_tag = requires(H& h, const std::u32string_view nam) { h.on_close_tag(nam); };
+        template<typename H> concept has_on_text = requires(H& h, const std::u32string_view txt) { h.on_text(txt); };
+        template<typename H> concept has_on_comment = requires(H& h, const std::u32string_view txt) { h.on_comment(txt); };
+        template<typename H> concept has_on_proc_instr = requires(H& h, const std::u32string_view txt) { h.on_proc_instr(txt); };
+        template<typename H> concept has_on_special_block = requires(H& h, const std::u32string_view txt) { h.on_special_block(txt); };
+
+        //-------------------------------------------------------------------
+        // Callbacks may return false to stop the parsing
+        template<typename F> [[nodiscard]] constexpr bool invoke_callback(F&& f)
+           {
+            if constexpr( std::same_as<decltype(f()), bool> )
+               {
+                return f();
+               }
+            else
+               {
+                f();
+                return true;
+               }
+           }
+       }
+
+//---------------------------------------------------------------------------
+template<typename H>
+concept a_handler = details::has_on_open_tag<H> or details::has_on_attribute<H> or details::has_on_close_tag<H> or
+                    details::has_on_text<H> or details::has_on_comment<H> or details::has_on_proc_instr<H> or details::has_on_special_block<H>;
+
+
+//---------------------------------------------------------------------------
+// Push parsing: events are dispatched to the callbacks of the handler,
+// the absent ones compile away: their events are skipped by the parser
+// and the values they'd get aren't decoded.
+// Attributes are notified after their open tag
+// struct Handler { void on_open_tag(std::u32string_view nam); };
+// xml::parse<enc>(bytes, handler);
+template<text::Enc enc, a_handler Handler>
+void parse(const std::string_view bytes, Handler& handler, const Engine engine =Engine::CODEPOINT)
+{
+    Parser<enc> parser{bytes, engine};
+    parser.options().set_collect_comment_text( details::has_on_comment<Handler> );
+    parser.options().set_collect_text_sections( details::has_on_text<Handler> );
+    parser.options().set_collect_attributes( details::has_on_attribute<Handler> );
+    parser.options().set_skip(SkippableEvent::COMMENT, not details::has_on_comment<Handler>);
+    parser.options().set_skip(SkippableEvent::TEXT, not details::has_on_text<Handler>);
+    parser.options().set_skip(SkippableEvent::PROCINST, not details::has_on_proc_instr<Handler>);
+    parser.options().set_skip(SkippableEvent::SPECIALBLOCK, not details::has_on_special_block<Handler>);
+    if constexpr( not details::has_on_open_tag<Handler> and not details::has_on_close_tag<Handler> )
+       {// Tags just to reach their attributes
+        parser.options().set_decode_tag_names(false);
+       }
+
+    bool go_on = true;
+    while( go_on )
+       {
+        const ParserEvent& event = parser.next_event();
+        if( event.is_open_tag() )
+           {
+            if constexpr( details::has_on_open_tag<Handler> )
+               {
+                go_on = details::invoke_callback([&]{ return handler.on_open_tag(event.value()); });
+               }
+            if constexpr( details::has_on_attribute<Handler> )
+               {
+                for( auto it=event.attributes().begin(); go_on and it!=event.attributes().end(); ++it )
+                   {
+                    const std::optional<std::u32string_view> val = it->second.has_value() ? std::optional<std::u32string_view>{*it->second} : std::nullopt;
+                    go_on = details::invoke_callback([&]{ return handler.on_attribute(it->first, val); });
+                   }
+               }
+           }
+        else if( event.is_close_tag() )
+           {
+            if constexpr( details::has_on_close_tag<Handler> ) go_on = details::invoke_callback([&]{ return handler.on_close_tag(event.value()); });
+           }
+        else if( event.is_text() )
+           {
+            if constexpr( details::has_on_text<Handler> ) go_on = details::invoke_callback([&]{ return handler.on_text(event.value()); });
+           }
+        else if( event.is_comment() )
+           {
+            if constexpr( details::has_on_comment<Handler> ) go_on = details::invoke_callback([&]{ return handler.on_comment(event.value()); });
+           }
+        else if( event.is_proc_instr() )
+           {
+            if constexpr( details::has_on_proc_instr<Handler> ) go_on = details::invoke_callback([&]{ return handler.on_proc_instr(event.value()); });
+           }
+        else if( event.is_special_block() )
+           {
+            if constexpr( details::has_on_special_block<Handler> ) go_on = details::invoke_callback([&]{ return handler.on_special_block(event.value()); });
+           }
+        else
+           {// No more events
+            go_on = false;
+           }
+       }
+}
+
+
 }//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
 
 
@@ -433,6 +1714,9 @@ class Parser final
     else if( ev.is_text() )
         return fmt::format("text: {}", text::to_utf8(ev.value()));
 
+    else if( ev.is_text_chunk() )
+        return fmt::format("text chunk{}: {}", ev.is_last_chunk() ? " (last)" : "", ev.chunk_bytes());
+
     else if( ev.is_proc_instr() )
         return fmt::format("proc-instr: {}", text::to_utf8(ev.value()));
 
@@ -441,6 +1725,27 @@ class Parser final
 
     return "(none)";
    }
+//---------------------------------------------------------------------------
+template<text::Enc enc>
+[[nodiscard]] std::vector<std::string> collect_events(const std::string_view buf, const xml::Engine engine, const bool check_nesting =false)
+   {
+    std::vector<std::string> events;
+    xml::Parser<enc> parser{buf, engine};
+    parser.options().set_collect_comment_text(true);
+    parser.options().set_collect_text_sections(true);
+    parser.options().set_check_nesting(check_nesting);
+    try{
+        while( const xml::ParserEvent& event = parser.next_event() )
+           {
+            events.push_back( fmt::format("{} (bytes {}-{} inner {}-{} line {})", to_string(event), event.start_byte_offset(), event.end_byte_offset(), event.inner_byte_span().start, event.inner_byte_span().end, parser.curr_line()) );
+           }
+       }
+    catch( text::parse_error& e )
+       {
+        events.push_back( fmt::format("error (line {})", e.line()) );
+       }
+    return events;
+   }
 /////////////////////////////////////////////////////////////////////////////
 static ut::suite<"xml::Parser"> XmlParser_tests = []
 {////////////////////////////////////////////////////////////////////////////
@@ -510,6 +1815,7 @@ static ut::suite<"xml::Parser"> XmlParser_tests = []
         parser.options().set_collect_text_sections(true);
         parser.set_on_notify_issue(notify_sink);
         std::size_t n_event = 0u;
+        std::u32string decoded_buf;
         try{
             while( const xml::ParserEvent& event = parser.next_event() )
                {
@@ -526,11 +1832,13 @@ static ut::suite<"xml::Parser"> XmlParser_tests = []
                     case  8: expect(event.is_open_tag(U"tag3") and event.attributes().size()==0) << "got: " << to_string(event) << '\n'; break;
                     case  9: expect(event.is_text() and event.value()==U"blah") << "got: " << to_string(event) << '\n'; break;
                     case 10: expect(event.is_close_tag(U"tag3")) << "got: " << to_string(event) << '\n'; break;
-                    case 11: expect(event.is_open_tag(U"nms:tag4") and to_string(event.attributes())=="attr1=1&lt;2,attr2=42") << "got: " << to_string(event) << '\n'; break;
+                    case 11: expect(event.is_open_tag(U"nms:tag4") and to_string(event.attributes())=="attr1=1&lt;2,attr2=42") << "got: " << to_string(event) << '\n';
+                             expect(event.decoded_value_of(U"attr1", decoded_buf)==U"1<2"sv and event.decoded_value_of(U"attr2", decoded_buf)==U"42"sv and not event.decoded_value_of(U"none", decoded_buf)) << "decoded attribute\n";
+                             break;
                     case 12: expect(event.is_text() and event.value()==U"blah") << "got: " << to_string(event) << '\n'; break;
                     case 13: expect(event.is_close_tag(U"nms:tag4")) << "got: " << to_string(event) << '\n'; break;
-                    case 14: expect(event.is_text() and event.value()==U"some text\n") << "got: " << to_string(event) << '\n'; break;
-                    case 15: expect(event.is_text() and event.value()==U"\n  Some <>not parsed<> text\n") << "got: " << to_string(event) << '\n'; break;
+                    case 14: expect(event.is_text() and not event.is_cdata() and event.value()==U"some text\n") << "got: " << to_string(event) << '\n'; break;
+                    case 15: expect(event.is_text() and event.is_cdata() and event.value()==U"\n  Some <>not parsed<> text\n") << "got: " << to_string(event) << '\n'; break;
                     case 16: expect(event.is_open_tag(U"root") and event.attributes().size()==0) << "got: " << to_string(event) << '\n'; break;
                     case 17: expect(event.is_open_tag(U"child") and to_string(event.attributes())=="key1=123,key2=quoted value") << "got: " << to_string(event) << '\n'; break;
                     case 18: expect(event.is_close_tag(U"child")) << "got: " << to_string(event) << '\n'; break;
@@ -560,6 +1868,448 @@ static ut::suite<"xml::Parser"> XmlParser_tests = []
         expect( throws<text::parse_error>([&parser] { [[maybe_unused]] auto ev = parser.next_event(); }) ) << "unclosed comment should throw\n";
        };
 
+    ut::test("structural index engine") = []
+       {
+        const std::string buf = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                                "<!-- a - comment -- with > dashes --->\n"
+                                "<prj name=\"a&amp;b\" x='1' empty=\"\">\n"
+                                "    <lib name=\"lib.pll\">\n"
+                                "        <![CDATA[\n"
+                                "            IF a<b AND c>d THEN (* it's \"quoted\" *) ]]] ]>\n"
+                                "        ]]>\n"
+                                "    </lib>\n"
+                                "    it's a long text, longer than a block: "s + std::string(150,'.') + "\n"
+                                "    <!DOCTYPE none>\n"
+                                "    <lib name=\"àèìòù⟶\"/>\n"
+                                "</prj>\n"s;
+
+        const auto test_enc = [&buf]<text::Enc ENC>() -> void
+           {
+            const std::string bytes = text::re_encode<text::Enc::UTF8,ENC>(buf);
+            const auto expected = collect_events<ENC>(bytes, xml::Engine::CODEPOINT);
+            expect( that % expected.size()==11u );
+            expect( collect_events<ENC>(bytes, xml::Engine::STRUCTURAL_INDEX)==expected ) << "engines should give same events\n";
+
+            const std::string unclosed = bytes + text::re_encode<text::Enc::UTF8,ENC>("<!-- \n\n"sv);
+            const auto expected_err = collect_events<ENC>(unclosed, xml::Engine::CODEPOINT);
+            expect( that % expected_err.back()=="error (line 13)"sv );
+            expect( collect_events<ENC>(unclosed, xml::Engine::STRUCTURAL_INDEX)==expected_err ) << "engines should fail the same way\n";
+           };
+        test_enc.template operator()<text::Enc::UTF8>();
+        test_enc.template operator()<text::Enc::UTF16LE>();
+        test_enc.template operator()<text::Enc::UTF16BE>();
+        test_enc.template operator()<text::Enc::UTF32LE>();
+        test_enc.template operator()<text::Enc::UTF32BE>();
+       };
+
+    ut::test("byte spans") = []
+       {
+        const std::string_view buf = "<a x=\"1\" yy = 22 z>\n <b k=\"\"/>text</a>"sv;
+        const auto test_engine = [buf](const xml::Engine engine, const bool collect_attributes) -> void
+           {
+            xml::Parser<text::Enc::UTF8> parser{buf, engine};
+            parser.options().set_collect_attributes(collect_attributes);
+
+            const xml::ParserEvent& a = parser.next_event();
+            expect( that % a.byte_span().bytes_of(buf)=="<a x=\"1\" yy = 22 z>"sv );
+            expect( that % a.attributes_spans().size()==3u );
+            expect( that % a.attributes_spans()[0].name.bytes_of(buf)=="x"sv and a.attributes_spans()[0].value->bytes_of(buf)=="1"sv );
+            expect( that % a.attributes_spans()[1].name.bytes_of(buf)=="yy"sv and a.attributes_spans()[1].value->bytes_of(buf)=="22"sv );
+            expect( that % a.attributes_spans()[2].name.bytes_of(buf)=="z"sv and not a.attributes_spans()[2].value.has_value() );
+            expect( that % a.attributes().size()==(collect_attributes ? 3u : 0u) );
+
+            const xml::ParserEvent& b = parser.next_event();
+            expect( that % b.byte_span().bytes_of(buf)=="<b k=\"\"/>"sv and b.attributes_spans()[0].value->start==27u and b.attributes_spans()[0].value->size()==0u );
+            const xml::ParserEvent& b_close = parser.next_event();
+            expect( b_close.is_close_tag(U"b") and b_close.byte_span()==xml::ByteSpan{21u,30u} and b_close.inner_byte_span()==xml::ByteSpan{30u,30u} ) << "self closing tag\n";
+            expect( that % parser.next_event().byte_span().bytes_of(buf)=="text"sv );
+            const xml::ParserEvent& a_close = parser.next_event();
+            expect( that % a_close.byte_span().bytes_of(buf)=="</a>"sv and a_close.inner_byte_span().bytes_of(buf)=="\n <b k=\"\"/>text"sv );
+            expect( not parser.next_event() );
+           };
+        test_engine(xml::Engine::CODEPOINT, true);
+        test_engine(xml::Engine::CODEPOINT, false);
+        test_engine(xml::Engine::STRUCTURAL_INDEX, true);
+       };
+
+    ut::test("lazy attributes") = []
+       {
+        const std::string buf = "<prj name=\"p\" descr='a > \"b\"'>\n"
+                                "  <lib name=\"à.pll\" link/>\n"
+                                "  <lib name = b.pll />\n"
+                                "  <lib/><x a=1 a=2></x>\n"
+                                "</prj>\n";
+        const auto test_enc = [&buf]<text::Enc ENC>(const xml::Engine engine) -> void
+           {
+            const std::string bytes = text::re_encode<text::Enc::UTF8,ENC>(buf);
+            xml::Parser<ENC> parser{bytes, engine};
+            parser.options().set_lazy_attributes();
+            std::vector<std::string> got;
+            while( const xml::ParserEvent& event = parser.next_event() )
+               {
+                if( event.is_open_tag() )
+                   {
+                    expect( event.attributes().size()==0u ) << "shouldn't collect attributes\n";
+                    auto attrs = parser.lazy_attributes();
+                    got.push_back( fmt::format("{}:{}:{}", text::to_utf8(event.value()), attrs.size(), text::to_utf8(attrs.value_of(U"name").value_or(U"-"))) );
+                   }
+                else if( event.is_close_tag() )
+                   {
+                    got.push_back( "/" + text::to_utf8(event.value()) );
+                   }
+               }
+            expect( got==std::vector<std::string>{"prj:2:p", "lib:2:à.pll", "/lib", "lib:1:b.pll", "/lib", "lib:0:-", "/lib", "x:2:-", "/x", "/prj"} );
+           };
+        test_enc.template operator()<text::Enc::UTF8>(xml::Engine::CODEPOINT);
+        test_enc.template operator()<text::Enc::UTF8>(xml::Engine::STRUCTURAL_INDEX);
+        test_enc.template operator()<text::Enc::UTF16BE>(xml::Engine::CODEPOINT);
+        test_enc.template operator()<text::Enc::UTF16BE>(xml::Engine::STRUCTURAL_INDEX);
+
+        xml::Parser<text::Enc::UTF8> parser{buf};
+        [[maybe_unused]] const auto& prj = parser.next_event();
+        auto attrs = parser.lazy_attributes();
+        expect( attrs.contains(U"descr") and not attrs.contains(U"none") ) << "should work also collecting attributes\n";
+        expect( attrs.value_of(U"descr")==U"a > \"b\""s ) << "single quoted value\n";
+        expect( attrs.decode_all()==parser.curr_event().attributes() );
+
+        xml::Parser<text::Enc::UTF8> entities_parser{"<a x=\"1&lt;2\" y=\"plain\">3 &gt; 2</a>"sv};
+        entities_parser.options().set_collect_text_sections();
+        [[maybe_unused]] const auto& a = entities_parser.next_event();
+        auto a_attrs = entities_parser.lazy_attributes();
+        expect( a_attrs.raw_value_of(U"x")=="1&lt;2"sv and a_attrs.decoded_value_of(U"x")==U"1<2"s and a_attrs.decoded_value_of(U"y")==U"plain"s );
+        std::u32string decoded_buf;
+        const auto& txt = entities_parser.next_event();
+        expect( txt.value()==U"3 &gt; 2"sv and txt.decoded_value(decoded_buf)==U"3 > 2"sv ) << "decoding is on access\n";
+
+        xml::Parser<text::Enc::UTF8> broken{"<a x=\"1>\n"sv};
+        broken.options().set_lazy_attributes();
+        expect( throws<text::parse_error>([&broken]{ [[maybe_unused]] auto ev = broken.next_event(); }) ) << "unclosed quote should throw\n";
+       };
+
+    ut::test("push parsing") = []
+       {
+        const std::string_view buf = "<?xml version=\"1.0\"?>\n"
+                                     "<!-- cmt -->\n"
+                                     "<prj name=\"p\">\n"
+                                     "  <lib name=\"a.pll\" link/><lib name=\"b.pll\">text</lib>\n"
+                                     "</prj>\n";
+
+        struct tags_handler_t
+           {
+            std::string s;
+            void on_open_tag(const std::u32string_view nam) { s += '<' + text::to_utf8(nam); }
+            void on_attribute(const std::u32string_view nam, const std::optional<std::u32string_view> val) { s += ' ' + text::to_utf8(nam) + (val ? '=' + text::to_utf8(*val) : ""s); }
+            void on_close_tag(const std::u32string_view nam) { s += "</" + text::to_utf8(nam) + '>'; }
+           } tags_handler;
+        static_assert( xml::a_handler<tags_handler_t> and not xml::details::has_on_text<tags_handler_t> );
+        xml::parse<text::Enc::UTF8>(buf, tags_handler);
+        expect( that % tags_handler.s=="<prj name=p<lib name=a.pll link</lib><lib name=b.pll</lib></prj>"sv );
+        tags_handler.s.clear();
+        xml::parse<text::Enc::UTF8>(buf, tags_handler, xml::Engine::STRUCTURAL_INDEX);
+        expect( that % tags_handler.s=="<prj name=p<lib name=a.pll link</lib><lib name=b.pll</lib></prj>"sv ) << "text, comments and procinst skipped\n";
+
+        struct content_handler_t
+           {
+            std::string s;
+            void on_text(const std::u32string_view txt) { s += text::to_utf8(txt); }
+            void on_comment(const std::u32string_view txt) { s += text::to_utf8(txt); }
+           } content_handler;
+        xml::parse<text::Enc::UTF8>(buf, content_handler, xml::Engine::STRUCTURAL_INDEX);
+        expect( that % content_handler.s==" cmt text"sv );
+
+        struct stopping_handler_t
+           {
+            int n = 0;
+            [[nodiscard]] bool on_open_tag(const std::u32string_view nam) { ++n; return nam!=U"lib"; }
+           } stopping_handler;
+        xml::parse<text::Enc::UTF8>(buf, stopping_handler);
+        expect( that % stopping_handler.n==2 ) << "returning false should stop the parsing\n";
+
+        struct attributes_handler_t
+           {
+            std::string s;
+            void on_attribute(const std::u32string_view nam, const std::optional<std::u32string_view> val) { s += ' ' + text::to_utf8(nam) + (val ? '=' + text::to_utf8(*val) : ""s); }
+           } attributes_handler;
+        xml::parse<text::Enc::UTF8>(buf, attributes_handler);
+        expect( that % attributes_handler.s==" name=p name=a.pll link name=b.pll"sv ) << "tag names not needed\n";
+
+        xml::Parser<text::Enc::UTF8> parser{buf};
+        parser.options().set_decode_tag_names(false);
+        parser.options().set_check_nesting(true);
+        std::size_t tags = 0;
+        while( const xml::ParserEvent& event = parser.next_event() )
+           {
+            if( event.is_open_tag() or event.is_close_tag() )
+               {
+                ++tags;
+                expect( event.value().empty() and not event.name_byte_span().bytes_of(buf).empty() ) << "just the name span\n";
+               }
+           }
+        expect( that % tags==6u );
+       };
+
+    ut::test("text chunks") = []
+       {
+        const std::u32string content = U"IF a THEN ⟶ b; END_IF;"s;
+        const std::u32string u = U"<src><![CDATA["s + content + U"]]></src><e><![CDATA[]]></e>"s;
+        const auto test_engine = [&]<text::Enc ENC>(const xml::Engine engine) -> void
+           {
+            const std::string buf = text::to<ENC>(u);
+            xml::Parser<ENC> parser{buf, engine};
+            parser.options().set_text_chunk_bytes(4);
+            std::u32string collected;
+            std::size_t chunks = 0;
+            std::size_t max_size = 0;
+            std::size_t expected_start = 0;
+            [[maybe_unused]] const auto& src = parser.next_event();
+            while( const xml::ParserEvent& event = parser.next_event() )
+               {
+                if( not event.is_text_chunk() ) break;
+                if( chunks>0 ) expect( that % event.start_byte_offset()==expected_start ) << "chunks should be contiguous\n";
+                expected_start = event.end_byte_offset();
+                expect( that % event.byte_span().bytes_of(buf)==event.chunk_bytes() );
+                expect( event.is_cdata() );
+                collected += text::to_utf32<ENC>(event.chunk_bytes());
+                max_size = std::max(max_size, event.chunk_bytes().size());
+                ++chunks;
+                if( event.is_last_chunk() ) break;
+               }
+            expect( collected==content );
+            expect( that % max_size<=4u*text::code_unit_size<ENC> );
+            expect( that % chunks>=content.size()*text::code_unit_size<ENC>/4u );
+            expect( parser.next_event().is_close_tag(U"src") and parser.next_event().is_open_tag(U"e") );
+            const xml::ParserEvent& empty = parser.next_event();
+            expect( empty.is_text_chunk() and empty.is_last_chunk() and empty.chunk_bytes().empty() ) << "empty sections should give one chunk\n";
+            expect( parser.next_event().is_close_tag(U"e") and not parser.next_event() );
+           };
+        test_engine.template operator()<text::Enc::UTF8>(xml::Engine::CODEPOINT);
+        test_engine.template operator()<text::Enc::UTF8>(xml::Engine::STRUCTURAL_INDEX);
+        test_engine.template operator()<text::Enc::UTF16LE>(xml::Engine::CODEPOINT);
+        test_engine.template operator()<text::Enc::UTF32BE>(xml::Engine::STRUCTURAL_INDEX);
+
+        xml::Parser<text::Enc::UTF8> parser{"<a>some text</a>"sv};
+        parser.options().set_text_chunk_bytes(5);
+        [[maybe_unused]] const auto& a = parser.next_event();
+        expect( not parser.next_event().is_cdata() and that % to_string(parser.curr_event())=="text chunk: some "sv );
+        expect( that % to_string(parser.next_event())=="text chunk (last): text"sv );
+        expect( parser.next_event().is_close_tag(U"a") );
+       };
+
+    ut::test("nesting check") = []
+       {
+        const auto error_of = [](const std::string_view buf) -> std::string
+           {
+            xml::Parser<text::Enc::UTF8> parser{buf};
+            parser.options().set_check_nesting();
+            try{
+                while( parser.next_event() ) ;
+               }
+            catch( text::parse_error& e )
+               {
+                return fmt::format("{} (line {})", e.what(), e.line());
+               }
+            return {};
+           };
+        expect( that % error_of("<a>\n<b/>\n<c x=\"1\">txt</c>\n</a>\n"sv).empty() );
+        expect( that % error_of("<a>\n<b>\n</a>\n"sv).starts_with("Close tag `a` doesn't match `b`"sv) );
+        expect( that % error_of("<a>\n<b>\n</a>\n"sv).ends_with("(line 3)"sv) );
+        expect( that % error_of("<a>\n</a>\n</b>"sv).starts_with("Unexpected close tag `b`"sv) );
+        expect( that % error_of("<a>\n<b></b>\n"sv).starts_with("Unclosed tag `a`"sv) );
+
+        xml::Parser<text::Enc::UTF8> unchecked{"<a></b>"sv};
+        expect( unchecked.next_event().is_open_tag(U"a") and unchecked.next_event().is_close_tag(U"b") ) << "not checked by default\n";
+
+        xml::NameTable names;
+        expect( that % names.intern(U"a")==0u and names.intern(U"b")==1u and names.intern(U"a")==0u and names.name_of(1u)==U"b"sv );
+        expect( names.find(U"b")==1u and not names.find(U"c").has_value() and names.size()==2u );
+       };
+
+    ut::test("namespaces") = []
+       {
+        const std::string_view buf = "<root xmlns=\"urn:a\" xmlns:nms=\"urn:n\">\n"
+                                     "  <nms:tag4 x=\"1\"><inner/></nms:tag4>\n"
+                                     "  <sub xmlns=\"urn:b\" xmlns:nms=\"urn:n2\"><tag4/><nms:tag4/></sub>\n"
+                                     "  <tag4 xml:lang=\"it\"/><nms:tag4/>\n"
+                                     "</root>\n";
+        const auto test_parser = [buf](const bool lazy) -> void
+           {
+            xml::Parser<text::Enc::UTF8> parser{buf};
+            parser.options().set_resolve_namespaces();
+            parser.options().set_lazy_attributes(lazy);
+            const auto a = parser.namespace_id(U"urn:a");
+            const auto b = parser.namespace_id(U"urn:b");
+            const auto n = parser.namespace_id(U"urn:n");
+            const auto n2 = parser.namespace_id(U"urn:n2");
+            std::vector<std::string> tags;
+            while( const xml::ParserEvent& event = parser.next_event() )
+               {
+                if( event.is_open_tag() )
+                   {
+                    tags.push_back( fmt::format("{}:{}", event.namespace_id()==a ? "a" : event.namespace_id()==b ? "b" : event.namespace_id()==n ? "n" : event.namespace_id()==n2 ? "n2" : "?", text::to_utf8(event.local_name())) );
+                   }
+                else if( event.is_close_tag() and event.is_close_tag(n, U"tag4") )
+                   {
+                    tags.push_back("/n:tag4");
+                   }
+               }
+            expect( tags==std::vector<std::string>{"a:root", "n:tag4", "a:inner", "/n:tag4", "b:sub", "b:tag4", "n2:tag4", "a:tag4", "n:tag4", "/n:tag4"} ) << "lazy " << lazy << '\n';
+           };
+        test_parser(false);
+        test_parser(true);
+
+        xml::Parser<text::Enc::UTF8> undeclared{"<a><p:b/></a>"sv};
+        undeclared.options().set_resolve_namespaces();
+        [[maybe_unused]] const auto& a = undeclared.next_event();
+        expect( throws<text::parse_error>([&undeclared]{ [[maybe_unused]] const auto& b = undeclared.next_event(); }) ) << "undeclared prefix should throw\n";
+       };
+
+    ut::test("skipped events") = []
+       {
+        const std::string buf = "<?xml version=\"1.0\"?>\n"
+                                "<!DOCTYPE prj>\n"
+                                "<prj>\n"
+                                "  <!-- a comment with -- and -> -->\n"
+                                "  <lib name=\"a\">text &amp; more</lib>\n"
+                                "  <src><![CDATA[ IF a<b THEN ]] ]]></src>\n"
+                                "  " + std::string(200,'.') + "\n"
+                                "  <lib name=\"b\"/>\n"
+                                "</prj>\n";
+        const auto test_enc = [&buf]<text::Enc ENC>(const xml::Engine engine) -> void
+           {
+            const std::string bytes = text::re_encode<text::Enc::UTF8,ENC>(buf);
+            std::vector<std::string> expected;
+            std::size_t all_events = 0;
+            xml::Parser<ENC> full{bytes, engine};
+            while( const xml::ParserEvent& event = full.next_event() )
+               {
+                ++all_events;
+                if( event.is_open_tag() or event.is_close_tag() ) expected.push_back( fmt::format("{} (line {})", to_string(event), full.curr_line()) );
+               }
+
+            xml::Parser<ENC> parser{bytes, engine};
+            parser.options().set_skip(xml::SkippableEvent::COMMENT);
+            parser.options().set_skip(xml::SkippableEvent::TEXT);
+            parser.options().set_skip(xml::SkippableEvent::PROCINST);
+            parser.options().set_skip(xml::SkippableEvent::SPECIALBLOCK);
+            std::vector<std::string> got;
+            while( const xml::ParserEvent& event = parser.next_event() ) got.push_back( fmt::format("{} (line {})", to_string(event), parser.curr_line()) );
+            expect( that % expected.size()==8u and all_events==14u );
+            expect( got==expected );
+
+            const std::string unclosed = text::re_encode<text::Enc::UTF8,ENC>("<a>\n<!-- \n\n"sv);
+            xml::Parser<ENC> broken{unclosed, engine};
+            broken.options().set_skip(xml::SkippableEvent::COMMENT);
+            [[maybe_unused]] const auto& a = broken.next_event();
+            try{ [[maybe_unused]] const auto& cmt = broken.next_event(); expect(false); }
+            catch( text::parse_error& e ) { expect( that % e.line()==2u ) << "same line of the collecting path\n"; }
+           };
+        test_enc.template operator()<text::Enc::UTF8>(xml::Engine::CODEPOINT);
+        test_enc.template operator()<text::Enc::UTF8>(xml::Engine::STRUCTURAL_INDEX);
+        test_enc.template operator()<text::Enc::UTF16BE>(xml::Engine::CODEPOINT);
+        test_enc.template operator()<text::Enc::UTF32LE>(xml::Engine::CODEPOINT);
+
+        xml::Parser<text::Enc::UTF8>::Options options;
+        options.set_skip(xml::SkippableEvent::TEXT);
+        options.set_skip(xml::SkippableEvent::TEXT, false);
+        expect( not options.is_skip(xml::SkippableEvent::TEXT) and not options.is_skip(xml::SkippableEvent::COMMENT) );
+       };
+
+    ut::test("reset") = []
+       {
+        const std::string_view buf1 = "<a xmlns=\"urn:x\">\n<b x=\"1\"/>\n<!-- c -->\n</a>\n"sv;
+        const std::string_view buf2 = "<?xml version=\"1.0\"?>\n<prj xmlns=\"urn:x\">\n  <lib>text</lib>\n</prj>\n"sv;
+        for( const xml::Engine engine : {xml::Engine::CODEPOINT, xml::Engine::STRUCTURAL_INDEX} )
+           {
+            xml::Parser<text::Enc::UTF8> parser{buf1, engine};
+            parser.options().set_collect_comment_text(true);
+            parser.options().set_collect_text_sections(true);
+            parser.options().set_check_nesting(true);
+            parser.options().set_resolve_namespaces(true);
+            const auto x = parser.namespace_id(U"urn:x");
+            [[maybe_unused]] const auto& a = parser.next_event();
+            [[maybe_unused]] const auto& b = parser.next_event();
+            expect( parser.curr_event().is_open_tag(x, U"b") );
+
+            parser.reset(buf2); // Midway, with a pending tag close
+            expect( not parser.curr_event() and parser.curr_line()==1u );
+            std::vector<std::string> events;
+            while( const xml::ParserEvent& event = parser.next_event() )
+               {
+                events.push_back( fmt::format("{} (bytes {}-{} inner {}-{} line {})", to_string(event), event.start_byte_offset(), event.end_byte_offset(), event.inner_byte_span().start, event.inner_byte_span().end, parser.curr_line()) );
+                if( event.is_open_tag(U"lib") ) expect( event.is_open_tag(x, U"lib") ) << "namespace ids should survive a reset\n";
+               }
+            expect( events==collect_events<text::Enc::UTF8>(buf2, engine, true) );
+
+            parser.reset("<a><b></a>"sv);
+            [[maybe_unused]] const auto& a2 = parser.next_event();
+            [[maybe_unused]] const auto& b2 = parser.next_event();
+            expect( throws<text::parse_error>([&parser]{ [[maybe_unused]] const auto& ev = parser.next_event(); }) );
+            parser.reset(buf1);
+            std::size_t n = 0;
+            while( parser.next_event() ) ++n;
+            expect( that % n==5u ) << "usable after an error\n";
+           }
+       };
+
+    ut::test("events batches") = []
+       {
+        const std::string_view buf = "<?xml version=\"1.0\"?>\n"
+                                     "<!-- cmt -->\n"
+                                     "<!DOCTYPE prj>\n"
+                                     "<prj name=\"p\">\n"
+                                     "  <lib name=\"a.pll\" link/><lib name=\"b.pll\">text</lib><![CDATA[ x ]]>\n"
+                                     "  <e/><e/><e/>\n"
+                                     "</prj>\n";
+        // The same with both events, values where both have them
+        const auto format = [](const std::string_view value, const xml::ByteSpan span, const xml::ByteSpan inner) -> std::string
+           {
+            return fmt::format("{} (bytes {}-{} inner {}-{})", value, span.start, span.end, inner.start, inner.end);
+           };
+        const auto parse_batches = [&](const std::size_t batch_size, const xml::Engine engine) -> std::vector<std::string>
+           {
+            std::vector<std::string> events;
+            xml::Parser<text::Enc::UTF8> parser{buf, engine};
+            std::vector<xml::CompactEvent> batch(batch_size);
+            while( const std::size_t n = parser.next_events(batch) )
+               {
+                for( std::size_t i=0; i<n; ++i )
+                   {
+                    const xml::CompactEvent& ev = batch[i];
+                    const bool has_value = ev.kind!=xml::CompactEvent::type::PROCINST;
+                    events.push_back( format(has_value ? text::to_utf8(ev.value_of<text::Enc::UTF8>(buf)) : "", ev.span, ev.inner) );
+                   }
+                if( n<batch_size ) break;
+               }
+            return events;
+           };
+
+        std::vector<std::string> expected;
+        xml::Parser<text::Enc::UTF8> parser{buf};
+        parser.options().set_collect_comment_text(true);
+        parser.options().set_collect_text_sections(true);
+        while( const xml::ParserEvent& event = parser.next_event() )
+           {
+            expected.push_back( format(text::to_utf8(event.value()), event.byte_span(), event.is_open_tag() ? event.attributes_region() : event.is_close_tag() ? event.inner_byte_span() : xml::ByteSpan{}) );
+           }
+        expect( that % expected.size()==17u );
+        for( const std::size_t batch_size : {1u, 2u, 3u, 16u, 256u} )
+           {
+            expect( parse_batches(batch_size, xml::Engine::CODEPOINT)==expected ) << "batch size " << batch_size << '\n';
+            expect( parse_batches(batch_size, xml::Engine::STRUCTURAL_INDEX)==expected ) << "batch size " << batch_size << '\n';
+           }
+
+        xml::Parser<text::Enc::UTF8> checked{"<a><b></c></a>"sv};
+        checked.options().set_check_nesting(true);
+        std::array<xml::CompactEvent,8> batch;
+        expect( throws<text::parse_error>([&]{ [[maybe_unused]] auto n = checked.next_events(batch); }) ) << "nesting checked also with undecoded names\n";
+
+        xml::Parser<text::Enc::UTF8> broken{"<a><b x=\"1></b></a>"sv};
+        expect( throws<text::parse_error>([&]{ [[maybe_unused]] auto n = broken.next_events(batch); }) ) << "errors should be thrown as usual\n";
+
+        xml::Parser<text::Enc::UTF8> mixed{"<a><b/>t</a>"sv};
+        expect( mixed.next_events(std::span{batch}.first(2))==2u and mixed.next_event().is_close_tag(U"b") ) << "single events after a batch\n";
+       };
+
     ut::test("interface.xml sample") = [&notify_sink]
        {
         const std::string_view buf =
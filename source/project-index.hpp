@@ -0,0 +1,220 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  Where the linked libraries are in a project,
+//  saved aside to skip parsing it next time
+//  ---------------------------------------------
+//  #include "project-index.hpp" // ll::project_index
+//  ---------------------------------------------
+#include <cstdint> // std::uint64_t
+#include <cstring> // std::memcpy
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem> // std::filesystem
+namespace fs = std::filesystem;
+
+#include "text.hpp" // text::Enc, text::detect_encoding_of()
+#include "parser-xml.hpp" // xml::ByteSpan
+#include "memory_mapped_file.hpp" // sys::memory_mapped_file
+#include "splice_writer.hpp" // sys::splice_writer
+#include "library-cache.hpp" // ll::file_stamp, ll::hash64()
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace ll
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// A binary file aside the project with the content spans of its linked
+// libraries. It's valid if the project has the same stamp, encoding and
+// hash of the first bytes; the caller can still check that the spans
+// end with a close tag. Layout: header_t, then lib_header_t and name of
+// each library
+class project_index final
+{
+ public:
+    static constexpr std::size_t prefix_bytes = 64u * 1024u; // Hashed
+
+    struct lib_entry final
+       {
+        std::string name;
+        xml::ByteSpan content;
+        bool is_empty_element = false;
+       };
+
+ private:
+    static constexpr std::string_view magic{"LLINDEX1"};
+    struct header_t final
+       {
+        char magic[8];
+        std::uint64_t size;
+        std::int64_t mtime;
+        std::uint64_t prefix_hash;
+        std::uint32_t enc;
+        std::uint32_t libs_count;
+       };
+    struct lib_header_t final
+       {
+        std::uint64_t start;
+        std::uint64_t end;
+        std::uint32_t is_empty_element;
+        std::uint32_t name_size;
+       };
+
+    text::Enc m_enc = text::Enc::UTF8;
+    std::vector<lib_entry> m_libs;
+
+ public:
+    [[nodiscard]] static fs::path path_of(const fs::path& prj_pth)
+       {
+        fs::path pth{prj_pth};
+        pth += ".llindex";
+        return pth;
+       }
+
+    [[nodiscard]] text::Enc encoding() const noexcept { return m_enc; }
+    void set_encoding(const text::Enc enc) noexcept { m_enc = enc; }
+    [[nodiscard]] const std::vector<lib_entry>& libraries() const noexcept { return m_libs; }
+
+    //-----------------------------------------------------------------------
+    void add_library(std::string name, const xml::ByteSpan content, const bool is_empty_element)
+       {
+        m_libs.push_back( {std::move(name), content, is_empty_element} );
+       }
+
+    //-----------------------------------------------------------------------
+    // The index of the project whose content is given
+    void save(const fs::path& prj_pth, const std::string_view prj_bytes) const
+       {
+        const file_stamp stamp = file_stamp_of(prj_pth);
+        header_t header{};
+        std::memcpy(header.magic, magic.data(), sizeof(header.magic));
+        header.size = stamp.size;
+        header.mtime = stamp.mtime;
+        header.prefix_hash = hash64(prj_bytes.substr(0, prefix_bytes));
+        header.enc = static_cast<std::uint32_t>(m_enc);
+        header.libs_count = static_cast<std::uint32_t>(m_libs.size());
+
+        std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+        for( const lib_entry& lib : m_libs )
+           {
+            const lib_header_t lib_header{lib.content.start, lib.content.end, lib.is_empty_element ? 1u : 0u, static_cast<std::uint32_t>(lib.name.size())};
+            bytes.append(reinterpret_cast<const char*>(&lib_header), sizeof(lib_header));
+            bytes += lib.name;
+           }
+
+        sys::splice_writer out;
+        out.append_copy( std::move(bytes) );
+        out.write_to( path_of(prj_pth) );
+       }
+
+    //-----------------------------------------------------------------------
+    // Nothing if missing or not matching the given project content
+    [[nodiscard]] static std::optional<project_index> load(const fs::path& prj_pth, const std::string_view prj_bytes)
+       {
+        const fs::path pth = path_of(prj_pth);
+        std::error_code ec;
+        if( fs::file_size(pth, ec)<sizeof(header_t) or ec )
+           {
+            return std::nullopt;
+           }
+        try{
+            const sys::memory_mapped_file mapped{pth.string()};
+            std::string_view bytes = mapped.as_string_view();
+            header_t header;
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            bytes.remove_prefix(sizeof(header));
+            if( std::string_view{header.magic, sizeof(header.magic)}!=magic or
+                file_stamp{header.size, header.mtime}!=file_stamp_of(prj_pth) or
+                header.size!=prj_bytes.size() or
+                header.enc!=static_cast<std::uint32_t>(text::detect_encoding_of(prj_bytes).enc) or
+                header.prefix_hash!=hash64(prj_bytes.substr(0, prefix_bytes)) )
+               {
+                return std::nullopt;
+               }
+
+            project_index index;
+            index.m_enc = static_cast<text::Enc>(header.enc);
+            for( std::uint32_t i=0; i<header.libs_count; ++i )
+               {
+                lib_header_t lib_header;
+                if( bytes.size()<sizeof(lib_header) )
+                   {
+                    return std::nullopt;
+                   }
+                std::memcpy(&lib_header, bytes.data(), sizeof(lib_header));
+                bytes.remove_prefix(sizeof(lib_header));
+                if( bytes.size()<lib_header.name_size or lib_header.start>lib_header.end or lib_header.end>prj_bytes.size() )
+                   {
+                    return std::nullopt;
+                   }
+                index.add_library(std::string{bytes.substr(0, lib_header.name_size)}, {lib_header.start, lib_header.end}, lib_header.is_empty_element!=0);
+                bytes.remove_prefix(lib_header.name_size);
+               }
+            if( not bytes.empty() )
+               {
+                return std::nullopt;
+               }
+            return index;
+           }
+        catch( std::exception& )
+           {
+            return std::nullopt;
+           }
+       }
+};
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"ll::project_index"> project_index_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+
+    ut::test("save and load") = []
+       {
+        const fs::path dir = fs::temp_directory_path() / "~llupdate-index-test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        const fs::path prj_pth = dir / "prj.plcprj";
+        const auto write_project = [&prj_pth](const std::string_view content)
+           {
+            sys::splice_writer out;
+            out.append_ref(content);
+            out.write_to(prj_pth);
+           };
+        const std::string_view content = "<p><lib name=\"a\">x</lib><lib name=\"b\"/></p>"sv;
+        write_project(content);
+
+        ll::project_index index;
+        index.add_library("a", {16u, 17u}, false);
+        index.add_library("b", {37u, 37u}, true);
+        index.save(prj_pth, content);
+
+        const std::optional<ll::project_index> loaded = ll::project_index::load(prj_pth, content);
+        expect( loaded.has_value() ) << "should be loaded\n";
+        if( loaded )
+           {
+            expect( that % loaded->libraries().size()==2u );
+            expect( loaded->libraries()[0].name=="a" and loaded->libraries()[0].content==xml::ByteSpan{16u,17u} and not loaded->libraries()[0].is_empty_element );
+            expect( loaded->libraries()[1].name=="b" and loaded->libraries()[1].is_empty_element );
+           }
+
+        const std::string_view modified = "<p><lib name=\"a\">y</lib><lib name=\"b\"/></p>"sv;
+        write_project(modified);
+        fs::last_write_time(prj_pth, fs::last_write_time(prj_pth) + std::chrono::seconds(10));
+        expect( not ll::project_index::load(prj_pth, modified).has_value() ) << "project modified\n";
+        expect( not ll::project_index::load(dir / "other.plcprj", modified).has_value() );
+
+        fs::remove_all(dir);
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
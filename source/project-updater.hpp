@@ -5,13 +5,26 @@
 #include <stdexcept> // std::runtime_error
 #include <string>
 #include <string_view>
-//#include <vector>
+#include <vector>
+#include <future> // std::future
+#include <optional>
+#include <tuple>
+#include <algorithm> // std::ranges::replace, std::ranges::sort, std::ranges::all_of, std::clamp, std::min
+#include <atomic>
+#include <functional> // std::greater
+#include <thread> // std::jthread
 #include <fmt/core.h> // fmt::*
 #include <filesystem> // std::filesystem
 namespace fs = std::filesystem;
 
 #include "memory_mapped_file.hpp" // sys::memory_mapped_file
 #include "parser-xml.hpp" // xml::Parser
+#include "splice_writer.hpp" // sys::splice_writer
+#include "library-cache.hpp" // ll::library_cache
+#include "thread_pool.hpp" // MG::thread_pool
+#include "update-manifest.hpp" // ll::update_manifest
+#include "project-index.hpp" // ll::project_index
+#include "timings.hpp" // sys::scoped_timer
 
 
 //:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
@@ -36,81 +49,679 @@ enum class project_type : std::uint8_t { ppjs, plcprj };
 }
 
 
-//---------------------------------------------------------------------------
-template<text::Enc enc> void parse(const std::string_view buf)
-   {
-    xml::Parser<enc> parser{buf};
-    parser.options().set_collect_comment_text(false);
-    parser.options().set_collect_text_sections(false);
-    //parser.set_on_notify_issue(notify_sink);
+/////////////////////////////////////////////////////////////////////////////
+// The parsers of the projects, one for each encoding, reset for each
+// project to reuse their storage (one set for each worker of a batch).
+// Just the names of the lib tags are read, so the attributes are lazy
+class project_parsers final
+{
+ private:
+    std::tuple<std::optional<xml::Parser<text::Enc::UTF8>>,
+               std::optional<xml::Parser<text::Enc::UTF16LE>>,
+               std::optional<xml::Parser<text::Enc::UTF16BE>>,
+               std::optional<xml::Parser<text::Enc::UTF32LE>>,
+               std::optional<xml::Parser<text::Enc::UTF32BE>>> m_parsers;
 
-    while( const xml::ParserEvent& event = parser.next_event() )
+ public:
+    template<text::Enc enc> [[nodiscard]] xml::Parser<enc>& parser_for(const std::string_view bytes)
        {
-        if( event.is_open_tag(U"lib") and event.attributes().contains(U"name") )
+        std::optional<xml::Parser<enc>>& parser = std::get<std::optional<xml::Parser<enc>>>(m_parsers);
+        if( parser )
            {
-            fmt::print("{} opened at offset:{} line:{}\n", text::to_utf8(event.attributes()[U"name"].value()), event.start_byte_offset(), parser.curr_line());
+            parser->reset(bytes);
            }
-        else if( event.is_close_tag(U"lib") )
+        else
            {
-            fmt::print("closed at offset:{} line:{}\n", event.start_byte_offset(), parser.curr_line());
+            parser.emplace(bytes, xml::Engine::STRUCTURAL_INDEX);
+            parser->options().set_collect_comment_text(false);
+            parser->options().set_collect_text_sections(false);
+            parser->options().set_lazy_attributes(true);
+            parser->options().set_check_nesting(true);
+            parser->options().set_skip(xml::SkippableEvent::COMMENT);
+            parser->options().set_skip(xml::SkippableEvent::TEXT);
+            parser->options().set_skip(xml::SkippableEvent::PROCINST);
+            parser->options().set_skip(xml::SkippableEvent::SPECIALBLOCK);
            }
+        return *parser;
        }
-   }
+};
+
+
+    namespace details
+       {
+        /////////////////////////////////////////////////////////////////////
+        // A linked library in the project
+        struct lib_element final
+           {
+            std::string name; // Path of the library file, utf-8
+            xml::ByteSpan content; // Between the tags
+            bool is_empty_element = false; // <lib/>
+            fs::path path;
+            std::future<library_cache::block_t> block; // Invalid if not loading
+           };
+
+        //-------------------------------------------------------------------
+        // The spans of a valid index, if they're followed by close tags
+        template<text::Enc enc> [[nodiscard]] bool is_index_applicable(const project_index& index, const std::string_view bytes)
+           {
+            using namespace std::literals; // U"..."sv
+            const std::string close_tag = text::to<enc>(U"</lib"sv);
+            return index.encoding()==enc and std::ranges::all_of(index.libraries(), [&](const project_index::lib_entry& lib)
+               {
+                return lib.is_empty_element or bytes.substr(lib.content.end).starts_with(close_tag);
+               });
+           }
+
+        //-------------------------------------------------------------------
+        // The first callback is invoked as soon as a library is found, the
+        // second when its content span is known, returning false to stop.
+        // If an index of the project is given the parsing is skipped
+        template<text::Enc enc, typename F, typename G> [[nodiscard]] std::vector<lib_element> find_linked_libs(const std::string_view bytes, const project_index* const index, project_parsers& parsers, F&& on_lib_found, G&& on_lib_closed)
+           {
+            if( index and is_index_applicable<enc>(*index, bytes) )
+               {
+                std::vector<lib_element> libs(index->libraries().size());
+                for( std::size_t i=0; i<libs.size(); ++i )
+                   {
+                    libs[i].name = index->libraries()[i].name;
+                    libs[i].content = index->libraries()[i].content;
+                    libs[i].is_empty_element = index->libraries()[i].is_empty_element;
+                    on_lib_found(libs[i]);
+                   }
+                for( lib_element& lib : libs )
+                   {
+                    if( not on_lib_closed(lib) ) break;
+                   }
+                return libs;
+               }
+
+            const sys::scoped_timer timer{sys::phase::parsing, bytes.size()};
+            xml::Parser<enc>& parser = parsers.parser_for<enc>(bytes);
+
+            std::vector<lib_element> libs;
+            std::size_t open_lib_end = 0;
+            bool in_linked_lib = false;
+            std::size_t nested_libs = 0; // Open inside the content of the linked one
+            while( const xml::ParserEvent& event = parser.next_event() )
+               {
+                if( event.is_open_tag(U"lib") )
+                   {
+                    if( in_linked_lib )
+                       {
+                        ++nested_libs;
+                       }
+                    else if( auto attrs = parser.lazy_attributes(); attrs.value_of(U"link")==U"true" and attrs.contains(U"name") )
+                       {
+                        in_linked_lib = true;
+                        lib_element& lib = libs.emplace_back();
+                        lib.name = text::to_utf8(attrs.value_of(U"name").value_or(U""));
+                        open_lib_end = event.end_byte_offset();
+                        on_lib_found(lib);
+                       }
+                   }
+                else if( event.is_close_tag(U"lib") and in_linked_lib )
+                   {
+                    if( nested_libs>0 )
+                       {
+                        --nested_libs;
+                        continue;
+                       }
+                    libs.back().content = event.inner_byte_span();
+                    libs.back().is_empty_element = event.start_byte_offset()<open_lib_end;
+                    in_linked_lib = false;
+                    if( not on_lib_closed(libs.back()) )
+                       {
+                        return libs;
+                       }
+                   }
+               }
+            if( in_linked_lib )
+               {// Its content span is unknown
+                throw std::runtime_error( fmt::format("Library {} not closed", libs.back().name) );
+               }
+            return libs;
+           }
+
+        //-------------------------------------------------------------------
+        // Library names are written as in Windows
+        [[nodiscard]] fs::path lib_path_of(const std::string& lib_name, const fs::path& prj_pth)
+           {
+          #if defined(MS_WINDOWS)
+            fs::path lib_pth{lib_name};
+          #else
+            std::string generic_name{lib_name};
+            std::ranges::replace(generic_name, '\\', '/');
+            fs::path lib_pth{generic_name};
+          #endif
+            if( lib_pth.is_relative() )
+               {
+                lib_pth = prj_pth.parent_path() / lib_pth;
+               }
+            return lib_pth;
+           }
+
+        //-------------------------------------------------------------------
+        // Starts loading the found libraries in the pool, while the project
+        // is still being parsed
+        template<text::Enc enc> [[nodiscard]] auto library_loader(const fs::path& prj_pth, library_cache& cache, MG::thread_pool& pool)
+           {
+            return [&prj_pth, &cache, &pool](lib_element& lib)
+               {
+                lib.path = lib_path_of(lib.name, prj_pth);
+                if( fs::exists(lib.path) )
+                   {
+                    lib.block = pool.submit([&cache, lib_pth=lib.path]
+                       {
+                        sys::scoped_timer timer{sys::phase::library_loading};
+                        library_cache::block_t block = cache.block_of<enc>(lib_pth);
+                        timer.add_bytes(block->size());
+                        return block;
+                       });
+                   }
+               };
+           }
+
+        //-------------------------------------------------------------------
+        // The unchanged ranges of the project interleaved with the cached
+        // blocks of the linked libraries, not written if they're all equal
+        // to the embedded ones. Optionally gives the manifest of what was
+        // applied and the index of the written project. Returns the changed
+        // libraries count
+        template<text::Enc enc> std::size_t write_updated_project(const std::string_view bytes, const fs::path& prj_pth, const fs::path& out_pth, const bool write_unchanged, const bool sync, library_cache& cache, MG::thread_pool& pool, project_parsers& parsers, const project_index* const index, project_index* const new_index, update_manifest* const manifest, std::vector<std::string>& issues)
+           {
+            std::vector<lib_element> libs = find_linked_libs<enc>(bytes, index, parsers, library_loader<enc>(prj_pth, cache, pool), [](const lib_element&) noexcept { return true; });
+            std::ptrdiff_t shift = 0; // Of the spans in the written project
+
+            std::vector<library_cache::block_t> blocks; // Spliced, must outlive the write
+            blocks.reserve(libs.size());
+            sys::splice_writer out;
+            out.set_source_file(prj_pth, bytes);
+            std::size_t pos = 0; // Project bytes not yet spliced
+            std::size_t updated_count = 0;
+            std::optional<sys::scoped_timer> splice_timer{std::in_place, sys::phase::splicing}; // Includes waiting the libraries
+            for( lib_element& lib : libs )
+               {
+                xml::ByteSpan new_content{lib.content.start + static_cast<std::size_t>(shift), lib.content.end + static_cast<std::size_t>(shift)};
+                const auto add_to_new_index = [new_index, &lib, &new_content]
+                   {
+                    if( new_index ) new_index->add_library(lib.name, new_content, lib.is_empty_element);
+                   };
+                if( lib.is_empty_element )
+                   {
+                    add_to_new_index();
+                    issues.push_back( fmt::format("Library {} is an empty element, not updated", lib.name) );
+                    continue;
+                   }
+                if( not lib.block.valid() )
+                   {
+                    add_to_new_index();
+                    issues.push_back( fmt::format("Library {} not found", lib.path.string()) );
+                    if( manifest ) manifest->set_incomplete();
+                    continue;
+                   }
+                try{
+                    const std::string_view block = *blocks.emplace_back( lib.block.get() );
+                    if( manifest )
+                       {
+                        manifest->add_library(lib.path, block);
+                       }
+                    if( lib.content.bytes_of(bytes)!=block )
+                       {
+                        out.append_ref( bytes.substr(pos, lib.content.start - pos) );
+                        out.append_ref(block);
+                        pos = lib.content.end;
+                        ++updated_count;
+                        new_content.end = new_content.start + block.size();
+                        shift += static_cast<std::ptrdiff_t>(block.size()) - static_cast<std::ptrdiff_t>(lib.content.size());
+                       }
+                   }
+                catch( std::exception& e )
+                   {
+                    issues.push_back( fmt::format("Library {} not updated: {}", lib.path.string(), e.what()) );
+                    if( manifest ) manifest->set_incomplete();
+                   }
+                add_to_new_index();
+               }
+
+            splice_timer->add_bytes(out.size());
+            splice_timer.reset();
+            if( updated_count>0 or write_unchanged )
+               {
+                out.append_ref( bytes.substr(pos) );
+                out.write_to(out_pth, sync);
+               }
+            return updated_count;
+           }
+
+        //-------------------------------------------------------------------
+        // Why the embedded content differs from the library file, if so
+        [[nodiscard]] std::optional<std::string> stale_issue_of(lib_element& lib, const std::string_view bytes)
+           {
+            if( lib.is_empty_element )
+               {
+                return fmt::format("Library {} is an empty element", lib.name);
+               }
+            if( not lib.block.valid() )
+               {
+                return fmt::format("Library {} not found", lib.path.string());
+               }
+            try{
+                const library_cache::block_t block = lib.block.get();
+                if( lib.content.bytes_of(bytes)!=*block )
+                   {
+                    return fmt::format("Library {} is out of date", lib.name);
+                   }
+               }
+            catch( std::exception& e )
+               {
+                return fmt::format("Library {} can't be checked: {}", lib.path.string(), e.what());
+               }
+            return std::nullopt;
+           }
+
+        //-------------------------------------------------------------------
+        // The embedded libraries compared with the converted files, the
+        // sizes first, without writing anything. A full pass optionally
+        // gives the index of the project. Returns the stale count
+        template<text::Enc enc> std::size_t count_stale_libs(const std::string_view bytes, const fs::path& prj_pth, const bool stop_at_first, library_cache& cache, MG::thread_pool& pool, project_parsers& parsers, const project_index* const index, project_index* const new_index, std::vector<std::string>& issues)
+           {
+            std::size_t stale_count = 0;
+            const auto check = [&stale_count, &issues, bytes](lib_element& lib) -> bool
+               {
+                if( std::optional<std::string> issue = stale_issue_of(lib, bytes) )
+                   {
+                    issues.push_back( std::move(*issue) );
+                    ++stale_count;
+                    return false;
+                   }
+                return true;
+               };
+
+            if( stop_at_first )
+               {// Checking each one as soon as closed
+                [[maybe_unused]] const auto libs = find_linked_libs<enc>(bytes, index, parsers, library_loader<enc>(prj_pth, cache, pool), check);
+               }
+            else
+               {// Letting all the libraries load while parsing
+                std::vector<lib_element> libs = find_linked_libs<enc>(bytes, index, parsers, library_loader<enc>(prj_pth, cache, pool), [](const lib_element&) noexcept { return true; });
+                for( lib_element& lib : libs )
+                   {
+                    check(lib);
+                    if( new_index ) new_index->add_library(lib.name, lib.content, lib.is_empty_element);
+                   }
+               }
+            return stale_count;
+           }
+
+        //-------------------------------------------------------------------
+        // f.template operator()<enc>() with the given encoding
+        template<typename F> decltype(auto) visit_encoding(const text::Enc enc, F&& f)
+           {
+            switch( enc )
+               {using enum text::Enc;
+                case UTF8: return f.template operator()<UTF8>();
+                case UTF16LE: return f.template operator()<UTF16LE>();
+                case UTF16BE: return f.template operator()<UTF16BE>();
+                case UTF32LE: return f.template operator()<UTF32LE>();
+                case UTF32BE: return f.template operator()<UTF32BE>();
+               }
+            std::unreachable();
+           }
+       }
+
+
+/////////////////////////////////////////////////////////////////////////////
+// How an updated project is ensured to survive a crash: it's always
+// replaced atomically, but its content may still be in the OS cache
+enum class durability : std::uint8_t
+   {
+    none, // Leave the flush to the OS
+    file, // Flush the written file before replacing the project
+    full  // Also flush its directory after the rename
+   };
+
+
+/////////////////////////////////////////////////////////////////////////////
+struct update_options final
+   {
+    bool use_manifest = false; // Updating in place, see update_manifest
+    bool use_index = false; // Keep a project_index aside the project
+    durability sync = durability::file;
+   };
+
+
+    namespace details
+       {
+        //-------------------------------------------------------------------
+        // Nothing changed since the last update, just the files stamps
+        // compared (and the libraries hashed if touched)
+        [[nodiscard]] bool is_unchanged_since_manifest(const fs::path& prj_pth, library_cache& cache)
+           {
+            const fs::path manifest_pth = update_manifest::path_of(prj_pth);
+            std::optional<update_manifest> manifest = update_manifest::load(manifest_pth);
+            if( not manifest )
+               {
+                return false;
+               }
+            try{
+                const auto block_hash_of = [&cache, enc=manifest->encoding()](const fs::path& lib_pth)
+                   {
+                    return visit_encoding(enc, [&]<text::Enc ENC>(){ return hash64(*cache.block_of<ENC>(lib_pth)); });
+                   };
+                if( not manifest->is_up_to_date(prj_pth, block_hash_of) )
+                   {
+                    return false;
+                   }
+                if( manifest->is_refreshed() )
+                   {
+                    manifest->save(manifest_pth);
+                   }
+                return true;
+               }
+            catch( std::exception& )
+               {
+                return false;
+               }
+           }
+       }
+
 
 //---------------------------------------------------------------------------
-void update_project( const fs::path& prj_pth, fs::path out_pth, std::vector<std::string>& issues )
+// Writing in place, the updated project is written to a temporary file in
+// the same directory and then renamed over the original, once this is no
+// longer mapped: a crash leaves one of the two complete. Nothing is written
+// if the libraries are the same
+std::size_t update_project( const fs::path& prj_pth, const fs::path& out_pth, const update_options& options, library_cache& cache, MG::thread_pool& pool, project_parsers& parsers, std::vector<std::string>& issues )
 {
     const project_type prj_type = recognize_project_type(prj_pth);
-    const sys::memory_mapped_file mem_mapped_file{prj_pth.string()};
-    const std::string_view bytes{mem_mapped_file.as_string_view()};
+    const bool in_place = out_pth.empty();
+    const fs::path write_pth = in_place ? prj_pth.parent_path() / fmt::format("~{}.tmp", prj_pth.filename().string()) : out_pth;
 
-    if( bytes.empty() )
+    const bool use_manifest = in_place and options.use_manifest;
+    if( use_manifest and details::is_unchanged_since_manifest(prj_pth, cache) )
        {
-        throw std::runtime_error("No data to parse (empty file?)");
+        return 0;
        }
+    update_manifest manifest;
+    text::Enc prj_enc = text::Enc::UTF8;
+    const bool use_index = in_place and options.use_index;
+    project_index new_index;
+    bool is_index_valid = false;
+
+    std::size_t updated_count = 0;
+       {
+        const sys::memory_mapped_file mem_mapped_file{prj_pth.string()};
+        const std::string_view bytes{mem_mapped_file.as_string_view()};
+
+        if( bytes.empty() )
+           {
+            throw std::runtime_error("No data to parse (empty file?)");
+           }
+
+        switch( prj_type )
+           {using enum project_type;
+
+            case ppjs:
+                break;
 
-   const auto [enc, bom_size] = text::detect_encoding_of(bytes);
+            case plcprj:
+                break;
+           }
 
-   switch( prj_type )
-       {using enum project_type;
+           {
+            const sys::scoped_timer timer{sys::phase::encoding_detection, std::min(bytes.size(), text::max_bom_size)};
+            prj_enc = text::detect_encoding_of(bytes).enc;
+           }
+        const std::optional<project_index> index = use_index ? project_index::load(prj_pth, bytes) : std::nullopt;
+        is_index_valid = index.has_value();
+        try{
+            updated_count = details::visit_encoding(prj_enc, [&]<text::Enc ENC>()
+               {
+                return details::write_updated_project<ENC>(bytes, prj_pth, write_pth, not in_place, options.sync!=durability::none, cache, pool, parsers, index ? &*index : nullptr, use_index ? &new_index : nullptr, use_manifest ? &manifest : nullptr, issues);
+               });
+           }
+        catch( ... )
+           {
+            if( in_place )
+               {
+                std::error_code ec;
+                fs::remove(write_pth, ec);
+               }
+            throw;
+           }
+       }
 
-        case ppjs:
-            break;
+    if( in_place and updated_count>0 )
+       {
+        try{
+            sys::copy_permissions(prj_pth, write_pth);
+            fs::rename(write_pth, prj_pth);
+           }
+        catch( ... )
+           {
+            std::error_code ec;
+            fs::remove(write_pth, ec);
+            throw;
+           }
+       }
+    if( options.sync==durability::full and (updated_count>0 or not in_place) )
+       {
+        sys::sync_directory( fs::absolute(write_pth).parent_path() );
+       }
+    if( use_index and (updated_count>0 or not is_index_valid) )
+       {
+        const sys::memory_mapped_file written_file{prj_pth.string()};
+        new_index.set_encoding(prj_enc);
+        new_index.save(prj_pth, written_file.as_string_view());
+       }
+    if( use_manifest and manifest.is_complete() )
+       {// Just if all the libraries were applied
+        manifest.set_project(prj_pth, prj_enc);
+        manifest.save( update_manifest::path_of(prj_pth) );
+       }
+    return updated_count;
+}
 
-        case plcprj:
-            break;
+
+//---------------------------------------------------------------------------
+// Tells which linked libraries differ from their files, optionally
+// stopping at the first one. Returns the stale libraries count
+std::size_t check_project( const fs::path& prj_pth, const bool stop_at_first, const update_options& options, library_cache& cache, MG::thread_pool& pool, project_parsers& parsers, std::vector<std::string>& issues )
+{
+    [[maybe_unused]] const project_type prj_type = recognize_project_type(prj_pth);
+    const sys::memory_mapped_file mem_mapped_file{prj_pth.string()};
+    const std::string_view bytes{mem_mapped_file.as_string_view()};
+    if( bytes.empty() )
+       {
+        throw std::runtime_error("No data to parse (empty file?)");
        }
 
-    switch( enc )
-       {using enum text::Enc;
+    const text::Enc enc = [bytes]
+       {
+        const sys::scoped_timer timer{sys::phase::encoding_detection, std::min(bytes.size(), text::max_bom_size)};
+        return text::detect_encoding_of(bytes).enc;
+       }();
+    const std::optional<project_index> index = options.use_index ? project_index::load(prj_pth, bytes) : std::nullopt;
+    const bool make_index = options.use_index and not index and not stop_at_first;
+    project_index new_index;
+    const std::size_t stale_count = details::visit_encoding(enc, [&]<text::Enc ENC>()
+       {
+        return details::count_stale_libs<ENC>(bytes, prj_pth, stop_at_first, cache, pool, parsers, index ? &*index : nullptr, make_index ? &new_index : nullptr, issues);
+       });
+    if( make_index )
+       {
+        new_index.set_encoding(enc);
+        new_index.save(prj_pth, bytes);
+       }
+    return stale_count;
+}
 
-        case UTF8:
-            parse<UTF8>(bytes);
-            break;
 
-        case UTF16LE:
-            parse<UTF16LE>(bytes);
-            break;
+//---------------------------------------------------------------------------
+enum class batch_job : std::uint8_t
+   {
+    update,
+    check, // check_project() of all
+    check_until_stale // Stopping at the first stale library
+   };
 
-        case UTF16BE:
-            parse<UTF16BE>(bytes);
-            break;
+/////////////////////////////////////////////////////////////////////////////
+// The outcome of a project in a batch
+struct project_result final
+   {
+    fs::path path;
+    std::size_t updated_count = 0; // Stale ones if checking
+    std::vector<std::string> issues;
+    std::string error; // Not processed if not empty
 
-        case UTF32LE:
-            parse<UTF32LE>(bytes);
-            break;
+    [[nodiscard]] int exit_code() const noexcept { return not error.empty() ? 2 : (issues.empty() ? 0 : 1); }
+   };
 
-        case UTF32BE:
-            parse<UTF32BE>(bytes);
-            break;
+//---------------------------------------------------------------------------
+// Updates (or checks) the projects in place, each worker taking the
+// biggest project not yet taken, so the workers end together. The library
+// cache and pool are shared, the pool isn't used for the projects so its
+// tasks can be awaited by the workers
+[[nodiscard]] std::vector<project_result> update_projects( const std::vector<fs::path>& prj_pths, const batch_job job, const update_options& options, library_cache& cache, MG::thread_pool& pool, const std::size_t workers_count )
+{
+    std::vector<project_result> results(prj_pths.size());
+    std::vector<std::pair<std::uintmax_t,std::size_t>> biggest_first; // size, index
+    biggest_first.reserve(prj_pths.size());
+    for( std::size_t i=0; i<prj_pths.size(); ++i )
+       {
+        results[i].path = prj_pths[i];
+        std::error_code ec;
+        const std::uintmax_t siz = fs::file_size(prj_pths[i], ec);
+        biggest_first.emplace_back(ec ? 0u : siz, i);
        }
+    std::ranges::sort(biggest_first, std::greater{});
 
-    // Write
-    //if( out_pth.empty )
-    //   {
-    //   }
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> stale_found{false};
+    const auto work = [&]() noexcept
+       {
+        project_parsers parsers; // Reused by the projects of this worker
+        for( std::size_t n=next++; n<biggest_first.size(); n=next++ )
+           {
+            if( job==batch_job::check_until_stale and stale_found )
+               {
+                break;
+               }
+            project_result& result = results[biggest_first[n].second];
+            try{
+                if( job==batch_job::update )
+                   {
+                    result.updated_count = update_project(result.path, {}, options, cache, pool, parsers, result.issues);
+                   }
+                else
+                   {
+                    result.updated_count = check_project(result.path, job==batch_job::check_until_stale, options, cache, pool, parsers, result.issues);
+                   }
+               }
+            catch( text::parse_error& e )
+               {
+                result.error = fmt::format("{} (line {})", e.what(), e.line());
+               }
+            catch( std::exception& e )
+               {
+                result.error = e.what();
+               }
+            if( result.exit_code()>0 )
+               {
+                stale_found = true;
+               }
+           }
+       };
 
-    issues.push_back("Doing nothing for now");
+       {
+        std::vector<std::jthread> workers;
+        const std::size_t n = std::clamp<std::size_t>(workers_count, 1u, prj_pths.size());
+        workers.reserve(n);
+        for( std::size_t i=0; i<n; ++i )
+           {
+            workers.emplace_back(work);
+           }
+       } // Joined
+    return results;
 }
 
 }//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"ll::project-updater"> project_updater_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+    using ut::throws;
+
+    ut::test("find_linked_libs()") = []
+       {
+        const auto libs_of = [](const std::string_view bytes)
+           {
+            ll::project_parsers parsers;
+            return ll::details::find_linked_libs<text::Enc::UTF8>(bytes, nullptr, parsers, [](ll::details::lib_element&) noexcept {}, [](const ll::details::lib_element&) noexcept { return true; });
+           };
+
+        const std::string_view prj = "<prj>"
+                                     "<lib link=\"true\" name=\"a.plclib\"><plcLibrary><lib name=\"x.pll\" link=\"false\">x</lib><lib name=\"y\"/></plcLibrary></lib>"
+                                     "<lib link=\"false\" name=\"b.pll\">b</lib>"
+                                     "<lib link=\"true\" name=\"c.pll\"/>"
+                                     "</prj>"sv;
+        const std::vector<ll::details::lib_element> libs = libs_of(prj);
+        expect( that % libs.size()==2u ) << "nested libraries should be ignored\n";
+        if( libs.size()==2u )
+           {
+            expect( libs[0].name=="a.plclib" and libs[0].content.bytes_of(prj)=="<plcLibrary><lib name=\"x.pll\" link=\"false\">x</lib><lib name=\"y\"/></plcLibrary>"sv );
+            expect( libs[1].name=="c.pll" and libs[1].is_empty_element );
+           }
+
+        expect( throws([&libs_of]{ [[maybe_unused]] auto l = libs_of("<prj><lib link=\"true\" name=\"a.pll\">x"sv); }) ) << "unclosed library\n";
+       };
+
+    ut::test("manifest with issues") = []
+       {
+        const fs::path dir = fs::temp_directory_path() / "~llupdate-updater-test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        const auto write_file = [](const fs::path& pth, const std::string_view content)
+           {
+            sys::splice_writer out;
+            out.append_ref(content);
+            out.write_to(pth);
+           };
+        const fs::path prj_pth = dir / "prj.plcprj";
+        write_file(dir / "a.pll", "x := 1;"sv);
+
+        ll::library_cache cache;
+        MG::thread_pool pool(1);
+        ll::project_parsers parsers;
+        const ll::update_options options{.use_manifest=true};
+        std::vector<std::string> issues;
+        write_file(prj_pth, "<plcProject><libraries><lib link=\"true\" name=\"a.pll\"></lib><lib link=\"true\" name=\"e.pll\"/></libraries></plcProject>"sv);
+        expect( that % ll::update_project(prj_pth, {}, options, cache, pool, parsers, issues)==1u and issues.size()==1u );
+        expect( fs::exists(ll::update_manifest::path_of(prj_pth)) ) << "an empty element shouldn't prevent the manifest\n";
+
+        const auto manifest_time = fs::last_write_time(ll::update_manifest::path_of(prj_pth)) - std::chrono::seconds(10);
+        fs::last_write_time(ll::update_manifest::path_of(prj_pth), manifest_time);
+        expect( that % ll::update_project(prj_pth, {}, options, cache, pool, parsers, issues)==0u );
+        expect( fs::last_write_time(ll::update_manifest::path_of(prj_pth))==manifest_time ) << "an up to date manifest shouldn't be written\n";
+        fs::last_write_time(dir / "a.pll", fs::last_write_time(dir / "a.pll") + std::chrono::seconds(10));
+        expect( that % ll::update_project(prj_pth, {}, options, cache, pool, parsers, issues)==0u );
+        expect( fs::last_write_time(ll::update_manifest::path_of(prj_pth))!=manifest_time ) << "a touched library should refresh the manifest\n";
+
+        fs::remove(ll::update_manifest::path_of(prj_pth));
+        issues.clear();
+        write_file(prj_pth, "<plcProject><libraries><lib link=\"true\" name=\"a.pll\"></lib><lib link=\"true\" name=\"missing.pll\"></lib></libraries></plcProject>"sv);
+        expect( that % ll::update_project(prj_pth, {}, options, cache, pool, parsers, issues)==1u and issues.size()==1u );
+        expect( not fs::exists(ll::update_manifest::path_of(prj_pth)) ) << "a missing library should prevent the manifest\n";
+
+        fs::remove_all(dir);
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
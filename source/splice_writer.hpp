@@ -0,0 +1,391 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  Writes a file as a sequence of byte ranges
+//  taken from other buffers, without copying
+//  them in an intermediate one
+//  ---------------------------------------------
+//  #include "splice_writer.hpp" // sys::splice_writer
+//  ---------------------------------------------
+#include <algorithm> // std::min
+#include <cstdint> // std::uintptr_t
+#include <deque>
+#include <span>
+#include <stdexcept> // std::runtime_error
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h> // fmt::format
+#include <filesystem> // std::filesystem
+namespace fs = std::filesystem;
+
+#include "os-detect.hpp" // MS_WINDOWS, POSIX
+#include "system_base.hpp" // sys::get_lasterr_msg()
+#include "timings.hpp" // sys::scoped_timer
+
+#if defined(POSIX)
+  #include <cerrno> // errno
+  #include <cstring> // std::strerror
+  #include <fcntl.h> // open
+  #include <limits.h> // IOV_MAX
+  #include <sys/stat.h> // stat
+  #include <sys/uio.h> // writev
+  #include <unistd.h> // close, fsync, copy_file_range
+#endif
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace sys
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// The referenced ranges (ex. of a memory mapped file) must outlive the
+// writer, the others are kept by it. On POSIX the ranges are handed to
+// writev, so the kernel gathers them in a single sequential write.
+// If the referenced ranges are the mapped content of a file, on Linux
+// the big ones are copied from it with copy_file_range, that avoids
+// passing through user space and shares the extents on filesystems
+// supporting reflinks
+// sys::splice_writer out;
+// out.set_source_file(pth, bytes);
+// out.append_ref(bytes.substr(0,pos)); out.append_copy(block); out.append_ref(bytes.substr(end));
+// out.write_to("out.xml");
+class splice_writer final
+{
+ public:
+    static constexpr std::size_t min_copied_size = 64u * 1024u; // Smaller ranges are just written
+
+ private:
+    std::vector<std::string_view> m_pieces;
+    std::deque<std::string> m_owned; // Stable addresses
+    std::size_t m_size = 0;
+    fs::path m_src_pth;
+    std::string_view m_src_bytes; // Mapped content of m_src_pth
+
+ public:
+    [[nodiscard]] std::size_t pieces_count() const noexcept { return m_pieces.size(); }
+    [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+
+    //-----------------------------------------------------------------------
+    void set_source_file(fs::path pth, const std::string_view mapped_bytes)
+       {
+        m_src_pth = std::move(pth);
+        m_src_bytes = mapped_bytes;
+       }
+
+    //-----------------------------------------------------------------------
+    void append_ref(const std::string_view bytes)
+       {
+        if( not bytes.empty() )
+           {
+            m_pieces.push_back(bytes);
+            m_size += bytes.size();
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    void append_copy(std::string bytes)
+       {
+        if( not bytes.empty() )
+           {
+            append_ref( m_owned.emplace_back(std::move(bytes)) );
+           }
+       }
+
+    //-----------------------------------------------------------------------
+    // Overwrites the file if existing, optionally flushing it to the device
+    void write_to(const fs::path& pth, const bool sync =false) const
+       {
+        const scoped_timer timer{phase::writing, m_size};
+      #if defined(MS_WINDOWS)
+        HANDLE hFile = ::CreateFileA(pth.string().c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if( hFile==INVALID_HANDLE_VALUE )
+           {
+            throw std::runtime_error( fmt::format("Couldn't create {} ({})", pth.string(), get_lasterr_msg()) );
+           }
+        for( std::string_view piece : m_pieces )
+           {
+            while( not piece.empty() )
+               {
+                DWORD written = 0;
+                const DWORD to_write = static_cast<DWORD>( std::min<std::size_t>(piece.size(), 0x40000000u) );
+                if( not ::WriteFile(hFile, piece.data(), to_write, &written, nullptr) )
+                   {
+                    const std::string msg = get_lasterr_msg();
+                    ::CloseHandle(hFile);
+                    throw std::runtime_error( fmt::format("Couldn't write {} ({})", pth.string(), msg) );
+                   }
+                piece.remove_prefix(written);
+               }
+           }
+        if( sync and not ::FlushFileBuffers(hFile) )
+           {
+            const std::string msg = get_lasterr_msg();
+            ::CloseHandle(hFile);
+            throw std::runtime_error( fmt::format("Couldn't flush {} ({})", pth.string(), msg) );
+           }
+        ::CloseHandle(hFile);
+
+      #elif defined(POSIX)
+        const int fd = ::open(pth.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if( fd==-1 )
+           {
+            throw std::runtime_error( fmt::format("Couldn't create {} ({})", pth.string(), std::strerror(errno)) );
+           }
+        try{
+            write_pieces(fd);
+            if( sync and ::fsync(fd)==-1 )
+               {
+                throw std::runtime_error( std::strerror(errno) );
+               }
+           }
+        catch( std::exception& e )
+           {
+            ::close(fd);
+            throw std::runtime_error( fmt::format("Couldn't write {} ({})", pth.string(), e.what()) );
+           }
+        if( ::close(fd)==-1 )
+           {
+            throw std::runtime_error( fmt::format("Couldn't close {} ({})", pth.string(), std::strerror(errno)) );
+           }
+      #endif
+       }
+
+ private:
+  #if defined(POSIX)
+    //-----------------------------------------------------------------------
+    // The big ranges of the source file are copied, the others gathered
+    void write_pieces(const int fd) const
+       {
+      #if defined(__linux__)
+        int src_fd = m_src_pth.empty() ? -1 : ::open(m_src_pth.c_str(), O_RDONLY);
+      #else
+        int src_fd = -1;
+      #endif
+        try{
+            std::size_t first = 0; // Pieces not yet written
+            for( std::size_t i=0; i<m_pieces.size(); ++i )
+               {
+                if( src_fd!=-1 and is_copyable(m_pieces[i]) )
+                   {
+                    write_gathered(fd, std::span{m_pieces}.subspan(first, i-first));
+                    first = i + 1;
+                    const std::string_view rest = copy_from_source(src_fd, fd, m_pieces[i]);
+                    if( not rest.empty() )
+                       {// Not supported here, just write from now on
+                        ::close(src_fd);
+                        src_fd = -1;
+                        write_gathered(fd, std::span{&rest, 1});
+                       }
+                   }
+               }
+            write_gathered(fd, std::span{m_pieces}.subspan(first));
+           }
+        catch( ... )
+           {
+            if( src_fd!=-1 ) ::close(src_fd);
+            throw;
+           }
+        if( src_fd!=-1 ) ::close(src_fd);
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] std::size_t offset_in_source(const std::string_view piece) const noexcept
+       {
+        return reinterpret_cast<std::uintptr_t>(piece.data()) - reinterpret_cast<std::uintptr_t>(m_src_bytes.data());
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] bool is_copyable(const std::string_view piece) const noexcept
+       {
+        const std::size_t offset = offset_in_source(piece); // Wraps if before
+        return piece.size()>=min_copied_size and offset<=m_src_bytes.size() and piece.size()<=m_src_bytes.size()-offset;
+       }
+
+    //-----------------------------------------------------------------------
+    // Returns what wasn't copied because not supported
+    [[nodiscard]] std::string_view copy_from_source([[maybe_unused]] const int src_fd, [[maybe_unused]] const int fd, std::string_view piece) const
+       {
+      #if defined(__linux__)
+        ::off64_t src_offset = static_cast<::off64_t>(offset_in_source(piece));
+        while( not piece.empty() )
+           {
+            const ::ssize_t ret = ::copy_file_range(src_fd, &src_offset, fd, nullptr, piece.size(), 0u);
+            if( ret<0 )
+               {
+                if( errno==EINTR ) continue;
+                if( errno==ENOSYS or errno==EXDEV or errno==EINVAL or errno==EOPNOTSUPP ) break;
+                throw std::runtime_error( std::strerror(errno) );
+               }
+            if( ret==0 ) break; // Source file shorter than mapped?
+            piece.remove_prefix( static_cast<std::size_t>(ret) );
+           }
+      #endif
+        return piece;
+       }
+
+    //-----------------------------------------------------------------------
+    // At most IOV_MAX ranges per call, resuming after partial writes
+    static void write_gathered(const int fd, const std::span<const std::string_view> pieces)
+       {
+        std::vector<::iovec> iovs;
+        iovs.reserve( std::min<std::size_t>(pieces.size(), IOV_MAX) );
+        std::size_t next_piece = 0;
+        std::size_t first_iov = 0;
+        while( first_iov<iovs.size() or next_piece<pieces.size() )
+           {
+            // Refill the vector with the pieces not yet written
+            iovs.erase(iovs.begin(), iovs.begin() + static_cast<std::ptrdiff_t>(first_iov));
+            first_iov = 0;
+            while( iovs.size()<IOV_MAX and next_piece<pieces.size() )
+               {
+                const std::string_view piece = pieces[next_piece++];
+                iovs.push_back( ::iovec{const_cast<char*>(piece.data()), piece.size()} );
+               }
+
+            const ::ssize_t ret = ::writev(fd, iovs.data(), static_cast<int>(iovs.size()));
+            if( ret<0 )
+               {
+                if( errno==EINTR ) continue;
+                throw std::runtime_error( std::strerror(errno) );
+               }
+
+            // Skip what was written
+            std::size_t written = static_cast<std::size_t>(ret);
+            while( first_iov<iovs.size() and written>=iovs[first_iov].iov_len )
+               {
+                written -= iovs[first_iov].iov_len;
+                ++first_iov;
+               }
+            if( written>0 )
+               {
+                iovs[first_iov].iov_base = static_cast<char*>(iovs[first_iov].iov_base) + written;
+                iovs[first_iov].iov_len -= written;
+               }
+           }
+       }
+  #endif
+};
+
+
+
+//---------------------------------------------------------------------------
+// To replace a file with another one written aside: same permissions and,
+// where allowed, same owner
+inline void copy_permissions(const fs::path& from, const fs::path& to)
+{
+    fs::permissions(to, fs::status(from).permissions(), fs::perm_options::replace);
+  #if defined(POSIX)
+    struct stat sbuf {};
+    if( ::stat(from.c_str(), &sbuf)==0 )
+       {
+        [[maybe_unused]] const int ret = ::chown(to.c_str(), sbuf.st_uid, sbuf.st_gid); // Fails if not privileged
+       }
+  #endif
+}
+
+
+//---------------------------------------------------------------------------
+// So that a file renamed or created in the directory survives a crash
+inline void sync_directory([[maybe_unused]] const fs::path& dir)
+{
+  #if defined(POSIX)
+    const int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if( fd==-1 )
+       {
+        throw std::runtime_error( fmt::format("Couldn't open directory {} ({})", dir.string(), std::strerror(errno)) );
+       }
+    if( ::fsync(fd)==-1 )
+       {
+        const int err = errno;
+        ::close(fd);
+        throw std::runtime_error( fmt::format("Couldn't sync directory {} ({})", dir.string(), std::strerror(err)) );
+       }
+    ::close(fd);
+  #endif
+}
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"sys::splice_writer"> splice_writer_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+    using ut::throws;
+
+    const auto read_file = [](const fs::path& pth) -> std::string
+       {
+        const sys::memory_mapped_file mapped{pth.string()};
+        return std::string{mapped.as_string_view()};
+       };
+
+    ut::test("splicing") = [read_file]
+       {
+        const fs::path pth = fs::temp_directory_path() / "~llupdate-splice-test.txt";
+        const std::string_view src = "<prj><lib>old</lib></prj>";
+
+        sys::splice_writer out;
+        out.append_ref(src.substr(0, 10));
+        out.append_copy("new"s);
+        out.append_ref(""sv);
+        out.append_ref(src.substr(13));
+        expect( that % out.pieces_count()==3u and out.size()==25u );
+        out.write_to(pth);
+        expect( read_file(pth)=="<prj><lib>new</lib></prj>"sv );
+
+        sys::splice_writer many;
+        std::string expected;
+        for( std::size_t i=0; i<3000; ++i )
+           {
+            many.append_copy( std::to_string(i) );
+            many.append_ref( src.substr(i%src.size(), 1) );
+            expected += std::to_string(i);
+            expected += src[i%src.size()];
+           }
+        many.write_to(pth);
+        expect( read_file(pth)==expected ) << "more pieces than a writev call can take\n";
+        fs::remove(pth);
+
+        expect( throws<std::runtime_error>([&out]{ out.write_to("/nonexistent-dir/x.txt"); }) );
+       };
+
+    ut::test("copying from source file") = [read_file]
+       {
+        const fs::path src_pth = fs::temp_directory_path() / "~llupdate-splice-src.txt";
+        const fs::path pth = fs::temp_directory_path() / "~llupdate-splice-test.txt";
+        std::string content;
+        for( std::size_t i=0; content.size()<3u*sys::splice_writer::min_copied_size; ++i ) content += std::to_string(i);
+           {
+            sys::splice_writer src;
+            src.append_ref(content);
+            src.write_to(src_pth);
+           }
+
+        const sys::memory_mapped_file mapped{src_pth.string()};
+        const std::string_view bytes = mapped.as_string_view();
+        const std::size_t pos = sys::splice_writer::min_copied_size + 7u;
+        sys::splice_writer out;
+        out.set_source_file(src_pth, bytes);
+        out.append_ref(bytes.substr(0, pos));
+        out.append_copy("<new>"s);
+        out.append_ref(bytes.substr(pos, 10u));
+        out.append_ref(bytes.substr(pos + 10u));
+        out.write_to(pth, true);
+        expect( read_file(pth)==fmt::format("{}<new>{}", content.substr(0,pos), content.substr(pos)) );
+
+        fs::permissions(src_pth, fs::perms::owner_read | fs::perms::owner_write, fs::perm_options::replace);
+        sys::copy_permissions(src_pth, pth);
+        expect( fs::status(pth).permissions()==(fs::perms::owner_read | fs::perms::owner_write) ) << "permissions should be copied\n";
+
+        fs::remove(pth);
+        fs::remove(src_pth);
+        sys::sync_directory( fs::temp_directory_path() );
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
@@ -210,10 +210,10 @@ template<a_basic_string TKEY, typename TVAL> class string_map final
        }
 
 
-    [[nodiscard]] const_iterator begin() const noexcept { return m_v.begin(); }
-    [[nodiscard]] const_iterator end() const noexcept { return m_v.end(); }
-    [[nodiscard]] iterator begin() noexcept { return m_v.begin(); }
-    [[nodiscard]] iterator end() noexcept { return m_v.end(); }
+    [[nodiscard]] constexpr const_iterator begin() const noexcept { return m_v.begin(); }
+    [[nodiscard]] constexpr const_iterator end() const noexcept { return m_v.end(); }
+    [[nodiscard]] constexpr iterator begin() noexcept { return m_v.begin(); }
+    [[nodiscard]] constexpr iterator end() noexcept { return m_v.end(); }
 };
 
 
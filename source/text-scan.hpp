@@ -0,0 +1,253 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  Vectorized search of ascii codepoints
+//  in an encoded buffer
+//  ---------------------------------------------
+//  #include "text-scan.hpp" // text::mask_of_any<>(), text::find_any_of<>()
+//  ---------------------------------------------
+#include <cassert>
+#include <cstdint> // std::uint64_t
+#include <cstring> // std::memcpy
+#include <bit> // std::countr_zero, std::popcount, std::endian
+#include <array>
+#include <string_view>
+
+#include "text.hpp" // text::Enc, text::details::combine_chars()
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+  #define TEXT_SCAN_SSE2 1
+  #include <emmintrin.h> // _mm_*
+#endif
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace text
+{
+
+//---------------------------------------------------------------------------
+template<Enc enc> inline constexpr std::size_t code_unit_size = enc==Enc::UTF8 ? 1u : ((enc==Enc::UTF16LE or enc==Enc::UTF16BE) ? 2u : 4u);
+
+// Buffers are scanned in blocks of 64 code units, one bit each in a mask
+inline constexpr std::size_t units_per_block = 64u;
+template<Enc enc> inline constexpr std::size_t block_bytes = units_per_block * code_unit_size<enc>;
+
+
+    namespace details
+       {
+        //-------------------------------------------------------------------
+        // The value of the code unit pointed by p, endianness aware
+        template<Enc enc> [[nodiscard]] constexpr char32_t code_unit_at(const char* const p) noexcept
+           {
+            if constexpr(enc==Enc::UTF16LE) return combine_chars(p[1], p[0]);
+            else if constexpr(enc==Enc::UTF16BE) return combine_chars(p[0], p[1]);
+            else if constexpr(enc==Enc::UTF32LE) return combine_chars(p[3], p[2], p[1], p[0]);
+            else if constexpr(enc==Enc::UTF32BE) return combine_chars(p[0], p[1], p[2], p[3]);
+            else return static_cast<unsigned char>(p[0]);
+           }
+
+        //-------------------------------------------------------------------
+        template<Enc enc, char32_t... cps>
+        [[nodiscard]] constexpr std::uint64_t scalar_mask_of_any(const char* const block) noexcept
+           {
+            std::uint64_t mask = 0;
+            for( std::size_t i=0; i<units_per_block; ++i )
+               {
+                const char32_t cu = code_unit_at<enc>(block + i*code_unit_size<enc>);
+                mask |= static_cast<std::uint64_t>(((cu==cps) or ...)) << i;
+               }
+            return mask;
+           }
+
+      #if defined(TEXT_SCAN_SSE2)
+        //-------------------------------------------------------------------
+        // Compare the lanes with an ascii codepoint as loaded by a little endian cpu
+        template<Enc enc, char32_t cp> [[nodiscard]] inline __m128i cmpeq(const __m128i v) noexcept
+           {
+            if constexpr(enc==Enc::UTF16LE) return _mm_cmpeq_epi16(v, _mm_set1_epi16(static_cast<short>(cp)));
+            else if constexpr(enc==Enc::UTF16BE) return _mm_cmpeq_epi16(v, _mm_set1_epi16(static_cast<short>(cp << 8)));
+            else if constexpr(enc==Enc::UTF32LE) return _mm_cmpeq_epi32(v, _mm_set1_epi32(static_cast<int>(cp)));
+            else if constexpr(enc==Enc::UTF32BE) return _mm_cmpeq_epi32(v, _mm_set1_epi32(static_cast<int>(cp << 24)));
+            else return _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(cp)));
+           }
+
+        //-------------------------------------------------------------------
+        template<Enc enc, char32_t... cps> [[nodiscard]] inline __m128i cmpeq_any(const char* const p) noexcept
+           {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i acc = _mm_setzero_si128();
+            ((acc = _mm_or_si128(acc, cmpeq<enc,cps>(v))), ...);
+            return acc;
+           }
+
+        //-------------------------------------------------------------------
+        // One bit for each of the 16 code units pointed by p
+        template<Enc enc, char32_t... cps> [[nodiscard]] inline std::uint64_t mask16_of_any(const char* const p) noexcept
+           {
+            __m128i bytes_mask;
+            if constexpr(code_unit_size<enc> == 1u)
+               {
+                bytes_mask = cmpeq_any<enc,cps...>(p);
+               }
+            else if constexpr(code_unit_size<enc> == 2u)
+               {// Saturating pack keeps the all-ones lanes
+                bytes_mask = _mm_packs_epi16(cmpeq_any<enc,cps...>(p), cmpeq_any<enc,cps...>(p+16));
+               }
+            else
+               {
+                bytes_mask = _mm_packs_epi16(_mm_packs_epi32(cmpeq_any<enc,cps...>(p), cmpeq_any<enc,cps...>(p+16)),
+                                             _mm_packs_epi32(cmpeq_any<enc,cps...>(p+32), cmpeq_any<enc,cps...>(p+48)));
+               }
+            return static_cast<std::uint64_t>(static_cast<unsigned int>(_mm_movemask_epi8(bytes_mask)));
+           }
+      #endif
+       }
+
+
+//---------------------------------------------------------------------------
+// Mask of the code units equal to any of the given ascii codepoints
+// in a block of 64 units (all must be readable)
+template<Enc enc, char32_t... cps>
+[[nodiscard]] inline std::uint64_t mask_of_any(const char* const block) noexcept
+{
+    static_assert( sizeof...(cps)>0 and ((cps>0 and cps<0x80) and ...), "Only non null ascii codepoints" );
+  #if defined(TEXT_SCAN_SSE2)
+    constexpr std::size_t quarter = block_bytes<enc> / 4u;
+    return  details::mask16_of_any<enc,cps...>(block) |
+           (details::mask16_of_any<enc,cps...>(block + quarter) << 16) |
+           (details::mask16_of_any<enc,cps...>(block + 2*quarter) << 32) |
+           (details::mask16_of_any<enc,cps...>(block + 3*quarter) << 48);
+  #else
+    return details::scalar_mask_of_any<enc,cps...>(block);
+  #endif
+}
+
+
+//---------------------------------------------------------------------------
+// Mask of the block starting at byte_pos, handles a partial last block
+template<Enc enc, char32_t... cps>
+[[nodiscard]] inline std::uint64_t mask_of_any(const std::string_view bytes, const std::size_t byte_pos) noexcept
+{
+    assert( byte_pos<=bytes.size() );
+    if( bytes.size()-byte_pos >= block_bytes<enc> ) [[likely]]
+       {
+        return mask_of_any<enc,cps...>(bytes.data() + byte_pos);
+       }
+    // Zero padding won't match, a truncated last unit is excluded
+    std::array<char, block_bytes<enc>> block{};
+    std::memcpy(block.data(), bytes.data() + byte_pos, (bytes.size()-byte_pos) / code_unit_size<enc> * code_unit_size<enc>);
+    return mask_of_any<enc,cps...>(block.data());
+}
+
+
+//---------------------------------------------------------------------------
+// Byte offset of the first code unit equal to any of the given ascii
+// codepoints, starting from a code unit boundary
+// const std::size_t pos = text::find_any_of<UTF8,U'<',U'&'>(bytes, 0);
+template<Enc enc, char32_t... cps>
+[[nodiscard]] inline std::size_t find_any_of(const std::string_view bytes, std::size_t byte_pos) noexcept
+{
+    while( byte_pos<bytes.size() )
+       {
+        if( const std::uint64_t mask = mask_of_any<enc,cps...>(bytes, byte_pos) )
+           {
+            return byte_pos + static_cast<std::size_t>(std::countr_zero(mask)) * code_unit_size<enc>;
+           }
+        byte_pos += block_bytes<enc>;
+       }
+    return std::string_view::npos;
+}
+
+
+//---------------------------------------------------------------------------
+// Same for utf-32 strings in memory, position and result in codepoints
+template<char32_t... cps>
+[[nodiscard]] inline std::size_t find_any_of(const std::u32string_view s, const std::size_t pos) noexcept
+{
+    constexpr Enc native_enc = std::endian::native==std::endian::little ? Enc::UTF32LE : Enc::UTF32BE;
+    const std::string_view bytes{reinterpret_cast<const char*>(s.data()), s.size()*sizeof(char32_t)};
+    const std::size_t byte_pos = find_any_of<native_enc,cps...>(bytes, pos*sizeof(char32_t));
+    return byte_pos==std::string_view::npos ? std::u32string_view::npos : byte_pos/sizeof(char32_t);
+}
+
+
+//---------------------------------------------------------------------------
+template<Enc enc, char32_t... cps>
+[[nodiscard]] inline bool contains_any_of(const std::string_view bytes) noexcept
+{
+    return find_any_of<enc,cps...>(bytes, 0)!=std::string_view::npos;
+}
+
+
+//---------------------------------------------------------------------------
+// Number of code units equal to any of the given ascii codepoints,
+// ex. count_any_of<UTF8,U'\n'>(bytes) for the lines
+template<Enc enc, char32_t... cps>
+[[nodiscard]] inline std::size_t count_any_of(const std::string_view bytes) noexcept
+{
+    std::size_t count = 0;
+    for( std::size_t byte_pos=0; byte_pos<bytes.size(); byte_pos+=block_bytes<enc> )
+       {
+        count += static_cast<std::size_t>(std::popcount(mask_of_any<enc,cps...>(bytes, byte_pos)));
+       }
+    return count;
+}
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"text::find_any_of<>"> text_scan_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+    using enum text::Enc;
+
+    ut::test("utf-8 masks") = []
+       {
+        const std::string s = "<a>"s + std::string(60,'x') + "&\n<"s;
+        expect( that % text::mask_of_any<UTF8,U'<'>(s, 0)==0x1ull );
+        expect( that % text::mask_of_any<UTF8,U'<',U'>'>(s, 0)==0x5ull );
+        expect( that % text::mask_of_any<UTF8,U'&'>(s, 0)==(1ull << 63) );
+        expect( that % text::mask_of_any<UTF8,U'\n',U'<'>(s, 64)==0x3ull ) << "partial last block\n";
+        expect( that % text::mask_of_any<UTF8,U'<'>(""sv, 0)==0x0ull );
+       };
+
+    ut::test("find_any_of") = []
+       {
+        const std::string s = std::string(200,'-') + "<>"s;
+        expect( that % text::find_any_of<UTF8,U'<'>(s, 0)==200u );
+        expect( that % text::find_any_of<UTF8,U'>',U'<'>(s, 201)==201u );
+        expect( that % text::find_any_of<UTF8,U'&'>(s, 0)==std::string_view::npos );
+        expect( not text::contains_any_of<UTF8,U'&'>(s) and text::contains_any_of<UTF8,U'-'>(s) );
+        expect( not text::contains_any_of<UTF8,U'<'>("\xE2\x9F\xB6"sv) ) << "multibyte sequences never match ascii\n";
+        expect( that % text::count_any_of<UTF8,U'-'>(s)==200u and text::count_any_of<UTF8,U'<',U'>'>(s)==2u );
+
+        const std::u32string u = std::u32string(100,U'⟶') + U"<&"s;
+        expect( that % text::find_any_of<U'&',U'<'>(u, 0)==100u and text::find_any_of<U'&'>(u, 0)==101u );
+        expect( that % text::find_any_of<U'>'>(u, 0)==std::u32string_view::npos );
+       };
+
+    ut::test("wide encodings") = []
+       {
+        const std::u32string u = std::u32string(70,U'⟶') + U"a<"s + std::u32string(3,U'㰼') + U"<"s;
+        const auto test_enc = [&u]<text::Enc ENC>() -> void
+           {
+            const std::string bytes = text::to<ENC>(u);
+            constexpr std::size_t n = text::code_unit_size<ENC>;
+            expect( that % text::find_any_of<ENC,U'<'>(bytes, 0)==71u*n );
+            expect( that % text::find_any_of<ENC,U'<'>(bytes, 72u*n)==75u*n ) << "lookalike bytes in other code units shouldn't match\n";
+            expect( that % text::find_any_of<ENC,U'<'>(bytes.substr(0, bytes.size()-1), 72u*n)==std::string_view::npos ) << "truncated code unit shouldn't match\n";
+           };
+        test_enc.template operator()<UTF16LE>();
+        test_enc.template operator()<UTF16BE>();
+        test_enc.template operator()<UTF32LE>();
+        test_enc.template operator()<UTF32BE>();
+       };
+
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
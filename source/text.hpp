@@ -85,6 +85,7 @@ const char32_t null_codepoint = 0;
 //---------------------------------------------------------------------------
 // auto [enc, bom_size] = text::detect_encoding_of(bytes);
 struct bom_ret_t final { Enc enc; std::uint8_t bom_size; };
+inline constexpr std::size_t max_bom_size = 4; // The bytes examined at most
 bom_ret_t constexpr detect_encoding_of(const std::string_view bytes)
    {//      +--------------+-------------+-------+
     //      |  Encoding    |   Bytes     | Chars |
@@ -495,11 +496,11 @@ constexpr std::string re_encode_if_necessary(const std::string_view in_bytes)
 
 
 //---------------------------------------------------------------------------
-// const std::string out_bytes = text::encode_as<text::Enc::UTF8>(in_bytes);
+// Re-encode a buffer whose encoding is known just at runtime
+// const std::string out_bytes = text::re_encode_as<text::Enc::UTF8>(in_enc, in_bytes);
 template<text::Enc OUTENC>
-constexpr std::string encode_as(const std::string_view in_bytes)
+constexpr std::string re_encode_as(const text::Enc in_enc, const std::string_view in_bytes)
 {
-    const auto [in_enc, bom_size] = detect_encoding_of(in_bytes);
     switch( in_enc )
        {using enum text::Enc;
 
@@ -522,6 +523,15 @@ constexpr std::string encode_as(const std::string_view in_bytes)
 }
 
 
+//---------------------------------------------------------------------------
+// const std::string out_bytes = text::encode_as<text::Enc::UTF8>(in_bytes);
+template<text::Enc OUTENC>
+constexpr std::string encode_as(const std::string_view in_bytes)
+{
+    return re_encode_as<OUTENC>(detect_encoding_of(in_bytes).enc, in_bytes);
+}
+
+
 
 //-----------------------------------------------------------------------
 template<text::Enc INENC>
@@ -551,6 +561,37 @@ template<text::Enc INENC>
 }
 
 
+//-----------------------------------------------------------------------
+// Number of codepoints encoded in a buffer (no validation)
+template<text::Enc INENC>
+[[nodiscard]] constexpr std::size_t count_codepoints(const std::string_view bytes) noexcept
+{
+    using enum text::Enc;
+    std::size_t count = 0;
+    if constexpr( INENC==UTF8 )
+       {// Don't count continuation bytes
+        for( const char ch : bytes )
+           {
+            count += (static_cast<unsigned char>(ch) & 0xC0)!=0x80;
+           }
+       }
+    else if constexpr( INENC==UTF16LE or INENC==UTF16BE )
+       {// Don't count second surrogates
+        for( std::size_t i=0; (i+1)<bytes.size(); i+=2 )
+           {
+            const std::uint16_t codeunit = INENC==UTF16LE ? details::combine_chars(bytes[i+1], bytes[i])
+                                                          : details::combine_chars(bytes[i], bytes[i+1]);
+            count += codeunit<0xDC00 or codeunit>=0xE000;
+           }
+       }
+    else
+       {
+        count = bytes.size() / 4;
+       }
+    return count;
+}
+
+
 //---------------------------------------------------------------------------
 // Encode a char32_t sequence to OUTENC
 // const std::string out_bytes = text::to<UTF16LE>(U"abc");
@@ -971,6 +1012,15 @@ static ut::suite<"text::"> text_tests = []
         expect( text::to_utf32(u8"aà⟶♥♫"sv)==U"aà⟶♥♫"sv );
        };
 
+    ut::test("text::count_codepoints") = []
+       {
+        expect( that % text::count_codepoints<UTF8>(""sv)==0u );
+        expect( that % text::count_codepoints<UTF8>("aà⟶🍌"sv)==4u );
+        expect( that % text::count_codepoints<UTF16LE>(text::to<UTF16LE>(U"aà⟶🍌"sv))==4u );
+        expect( that % text::count_codepoints<UTF16BE>(text::to<UTF16BE>(U"aà⟶🍌"sv))==4u );
+        expect( that % text::count_codepoints<UTF32LE>(text::to<UTF32LE>(U"aà⟶🍌"sv))==4u );
+       };
+
 };///////////////////////////////////////////////////////////////////////////
 #endif // TEST_UNITS ////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
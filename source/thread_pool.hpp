@@ -0,0 +1,132 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  A basic pool of worker threads
+//  ---------------------------------------------
+//  #include "thread_pool.hpp" // MG::thread_pool
+//  ---------------------------------------------
+#include <algorithm> // std::max
+#include <type_traits> // std::invoke_result_t
+#include <functional> // std::function
+#include <memory> // std::make_shared
+#include <future> // std::packaged_task, std::future
+#include <mutex>
+#include <condition_variable>
+#include <thread> // std::jthread
+#include <deque>
+#include <vector>
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace MG
+{
+
+/////////////////////////////////////////////////////////////////////////////
+class thread_pool final
+{
+ private:
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping = false;
+    std::vector<std::jthread> m_threads; // Last, to be joined first
+
+ public:
+    explicit thread_pool(const std::size_t threads_count =std::thread::hardware_concurrency())
+       {
+        const std::size_t n = std::max<std::size_t>(1u, threads_count);
+        m_threads.reserve(n);
+        for( std::size_t i=0; i<n; ++i )
+           {
+            m_threads.emplace_back( [this]{ worker_loop(); } );
+           }
+       }
+
+    ~thread_pool() noexcept
+       {
+        {
+         std::scoped_lock lock(m_mutex);
+         m_stopping = true;
+        }
+        m_cv.notify_all();
+        m_threads.clear(); // Join, pending tasks are completed
+       }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_threads.size(); }
+
+    //-----------------------------------------------------------------------
+    // auto fut = pool.submit([]{ return 42; });
+    template<typename F>
+    [[nodiscard]] std::future<std::invoke_result_t<F>> submit(F&& f)
+       {
+        using ret_t = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<ret_t()>>(std::forward<F>(f));
+        std::future<ret_t> fut = task->get_future();
+        {
+         std::scoped_lock lock(m_mutex);
+         m_tasks.emplace_back( [task]{ (*task)(); } );
+        }
+        m_cv.notify_one();
+        return fut;
+       }
+
+ private:
+    void worker_loop()
+       {
+        while( true )
+           {
+            std::function<void()> task;
+            {
+             std::unique_lock lock(m_mutex);
+             m_cv.wait(lock, [this]{ return m_stopping or not m_tasks.empty(); });
+             if( m_tasks.empty() )
+                {// Stopping
+                 return;
+                }
+             task = std::move(m_tasks.front());
+             m_tasks.pop_front();
+            }
+            task(); // Exceptions are stored in the future
+           }
+       }
+};
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"MG::thread_pool"> thread_pool_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using ut::expect;
+    using ut::that;
+    using ut::throws;
+
+    ut::test("results") = []
+       {
+        MG::thread_pool pool(3);
+        expect( that % pool.size()==3u );
+        std::vector<std::future<int>> results;
+        for( int i=0; i<100; ++i )
+           {
+            results.push_back( pool.submit([i]{ return i*i; }) );
+           }
+        int sum = 0;
+        for( auto& res : results ) sum += res.get();
+        expect( that % sum==328350 );
+       };
+
+    ut::test("exceptions") = []
+       {
+        MG::thread_pool pool(1);
+        auto fut = pool.submit([]() -> int { throw std::runtime_error("err"); });
+        expect( throws<std::runtime_error>([&fut]{ [[maybe_unused]] auto n = fut.get(); }) ) << "exception should reach the future\n";
+       };
+
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
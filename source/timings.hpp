@@ -0,0 +1,257 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  Time spent in the processing phases, summed
+//  by scoped timers when enabled
+//  ---------------------------------------------
+//  #include "timings.hpp" // sys::scoped_timer, sys::timings()
+//  ---------------------------------------------
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint> // std::uint64_t
+#include <string>
+#include <string_view>
+#include <fmt/core.h> // fmt::format
+
+#include "os-detect.hpp" // MS_WINDOWS, POSIX
+#include "system_base.hpp" // Windows.h
+
+#if defined(POSIX)
+  #include <time.h> // clock_gettime
+#endif
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace sys
+{
+
+/////////////////////////////////////////////////////////////////////////////
+enum class phase : std::uint8_t
+   {
+    mapping,
+    encoding_detection,
+    parsing,
+    library_loading,
+    splicing,
+    writing
+   };
+inline constexpr std::size_t phases_count = 6u;
+
+//---------------------------------------------------------------------------
+[[nodiscard]] constexpr std::string_view name_of(const phase ph) noexcept
+{
+    switch( ph )
+       {using enum phase;
+        case mapping: return "mapping";
+        case encoding_detection: return "encoding_detection";
+        case parsing: return "parsing";
+        case library_loading: return "library_loading";
+        case splicing: return "splicing";
+        case writing: return "writing";
+       }
+    return "?";
+}
+
+
+    namespace details
+       {
+        //-------------------------------------------------------------------
+        // Of the calling thread
+        [[nodiscard]] inline std::uint64_t cpu_time_ns() noexcept
+           {
+          #if defined(MS_WINDOWS)
+            FILETIME creation, exit, kernel, user;
+            if( not ::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel, &user) )
+               {
+                return 0;
+               }
+            const auto ticks_of = [](const FILETIME& t) noexcept { return (static_cast<std::uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+            return 100u * (ticks_of(kernel) + ticks_of(user));
+          #elif defined(POSIX)
+            ::timespec ts{};
+            if( ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)!=0 )
+               {
+                return 0;
+               }
+            return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000u + static_cast<std::uint64_t>(ts.tv_nsec);
+          #else
+            return 0;
+          #endif
+           }
+       }
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Totals of each phase, collected from any thread. Phases may nest (ex.
+// a library loading includes its mapping) and run concurrently, so their
+// wall times may sum to more than the elapsed one
+class phase_timings final
+{
+ public:
+    struct totals_t final
+       {
+        std::uint64_t count = 0;
+        std::uint64_t wall_ns = 0;
+        std::uint64_t cpu_ns = 0;
+        std::uint64_t bytes = 0;
+
+        [[nodiscard]] double mb_per_s() const noexcept
+           {
+            return wall_ns>0 ? static_cast<double>(bytes) * 1e3 / static_cast<double>(wall_ns) : 0.0;
+           }
+       };
+
+ private:
+    struct counters_t final
+       {
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> wall_ns{0};
+        std::atomic<std::uint64_t> cpu_ns{0};
+        std::atomic<std::uint64_t> bytes{0};
+       };
+    std::array<counters_t, phases_count> m_counters;
+    std::atomic<bool> m_enabled{false};
+
+ public:
+    void enable() noexcept { m_enabled.store(true, std::memory_order_relaxed); }
+    [[nodiscard]] bool is_enabled() const noexcept { return m_enabled.load(std::memory_order_relaxed); }
+
+    //-----------------------------------------------------------------------
+    void add(const phase ph, const std::uint64_t wall_ns, const std::uint64_t cpu_ns, const std::uint64_t bytes) noexcept
+       {
+        counters_t& counters = m_counters[static_cast<std::size_t>(ph)];
+        counters.count.fetch_add(1u, std::memory_order_relaxed);
+        counters.wall_ns.fetch_add(wall_ns, std::memory_order_relaxed);
+        counters.cpu_ns.fetch_add(cpu_ns, std::memory_order_relaxed);
+        counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] totals_t totals_of(const phase ph) const noexcept
+       {
+        const counters_t& counters = m_counters[static_cast<std::size_t>(ph)];
+        return { counters.count.load(std::memory_order_relaxed),
+                 counters.wall_ns.load(std::memory_order_relaxed),
+                 counters.cpu_ns.load(std::memory_order_relaxed),
+                 counters.bytes.load(std::memory_order_relaxed) };
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] std::string report() const
+       {
+        std::string s = fmt::format("{:<20}{:>8}{:>12}{:>12}{:>14}{:>10}\n", "phase", "count", "wall [ms]", "cpu [ms]", "bytes", "MB/s");
+        for( std::size_t i=0; i<phases_count; ++i )
+           {
+            const phase ph = static_cast<phase>(i);
+            const totals_t t = totals_of(ph);
+            s += fmt::format("{:<20}{:>8}{:>12.3f}{:>12.3f}{:>14}{:>10.1f}\n", name_of(ph), t.count, static_cast<double>(t.wall_ns)/1e6, static_cast<double>(t.cpu_ns)/1e6, t.bytes, t.mb_per_s());
+           }
+        return s;
+       }
+
+    //-----------------------------------------------------------------------
+    // {"phases":[{"name":"mapping","count":1,"wall_ms":0.1,...},...]}
+    [[nodiscard]] std::string report_json() const
+       {
+        std::string s = "{\"phases\":[";
+        for( std::size_t i=0; i<phases_count; ++i )
+           {
+            const phase ph = static_cast<phase>(i);
+            const totals_t t = totals_of(ph);
+            if( i>0 ) s += ',';
+            s += fmt::format("{{\"name\":\"{}\",\"count\":{},\"wall_ms\":{:.3f},\"cpu_ms\":{:.3f},\"bytes\":{},\"mb_per_s\":{:.1f}}}", name_of(ph), t.count, static_cast<double>(t.wall_ns)/1e6, static_cast<double>(t.cpu_ns)/1e6, t.bytes, t.mb_per_s());
+           }
+        s += "]}\n";
+        return s;
+       }
+};
+
+
+//---------------------------------------------------------------------------
+// The ones collected by the scoped timers
+[[nodiscard]] inline phase_timings& timings() noexcept
+{
+    static phase_timings instance;
+    return instance;
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Adds the time spent in its scope to a phase, just reads an atomic flag
+// if the timings are not enabled
+// const sys::scoped_timer timer{sys::phase::parsing, bytes.size()};
+class scoped_timer final
+{
+ private:
+    phase m_phase;
+    std::uint64_t m_bytes;
+    bool m_active;
+    std::chrono::steady_clock::time_point m_start;
+    std::uint64_t m_cpu_start = 0;
+
+ public:
+    explicit scoped_timer(const phase ph, const std::size_t bytes =0) noexcept
+      : m_phase(ph)
+      , m_bytes(bytes)
+      , m_active(timings().is_enabled())
+       {
+        if( m_active )
+           {
+            m_cpu_start = details::cpu_time_ns();
+            m_start = std::chrono::steady_clock::now();
+           }
+       }
+
+    ~scoped_timer() noexcept
+       {
+        if( m_active )
+           {
+            const auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+            const std::uint64_t cpu_end = details::cpu_time_ns();
+            timings().add(m_phase, static_cast<std::uint64_t>(wall.count()), cpu_end>m_cpu_start ? cpu_end-m_cpu_start : 0u, m_bytes);
+           }
+       }
+
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+
+    void add_bytes(const std::size_t bytes) noexcept { m_bytes += bytes; }
+};
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"sys::timings"> timings_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using ut::expect;
+    using ut::that;
+
+    ut::test("scoped_timer") = []
+       {
+        const sys::phase_timings::totals_t before = sys::timings().totals_of(sys::phase::splicing);
+           {
+            const sys::scoped_timer timer{sys::phase::splicing, 10u};
+           }
+        expect( that % sys::timings().totals_of(sys::phase::splicing).count==before.count ) << "not enabled\n";
+
+        sys::timings().enable();
+           {
+            sys::scoped_timer timer{sys::phase::splicing, 10u};
+            timer.add_bytes(5u);
+           }
+        const sys::phase_timings::totals_t after = sys::timings().totals_of(sys::phase::splicing);
+        expect( that % after.count==before.count+1u and after.bytes==before.bytes+15u );
+
+        const std::string report = sys::timings().report();
+        expect( report.find("splicing")!=std::string::npos and report.find("library_loading")!=std::string::npos );
+        const std::string json = sys::timings().report_json();
+        expect( json.starts_with("{\"phases\":[{\"name\":\"mapping\"") and json.ends_with("}]}\n") );
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
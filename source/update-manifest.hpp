@@ -0,0 +1,275 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  What was applied to a project in the last
+//  update, to skip the next one if unchanged
+//  ---------------------------------------------
+//  #include "update-manifest.hpp" // ll::update_manifest
+//  ---------------------------------------------
+#include <algorithm> // std::min
+#include <charconv> // std::from_chars
+#include <cstdint> // std::uint64_t
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h> // fmt::format
+#include <filesystem> // std::filesystem
+namespace fs = std::filesystem;
+
+#include "text.hpp" // text::Enc
+#include "memory_mapped_file.hpp" // sys::memory_mapped_file
+#include "splice_writer.hpp" // sys::splice_writer
+#include "library-cache.hpp" // ll::file_stamp, ll::hash64()
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace ll
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// A small text file aside the project, telling its stamp after the update
+// and the libraries that were applied, so the next run can decide with
+// a stat of each file whether there's something to do:
+//  llmanifest 1
+//  project <size> <mtime> <encoding>
+//  lib <size> <mtime> <block hash> <path>
+class update_manifest final
+{
+ public:
+    struct lib_entry final
+       {
+        fs::path path;
+        file_stamp stamp;
+        std::uint64_t block_hash = 0;
+       };
+
+ private:
+    file_stamp m_prj_stamp;
+    text::Enc m_enc = text::Enc::UTF8;
+    std::vector<lib_entry> m_libs;
+    bool m_is_complete = true;
+    bool m_is_refreshed = false;
+
+ public:
+    [[nodiscard]] static fs::path path_of(const fs::path& prj_pth)
+       {
+        fs::path pth{prj_pth};
+        pth += ".llmanifest";
+        return pth;
+       }
+
+    [[nodiscard]] text::Enc encoding() const noexcept { return m_enc; }
+    [[nodiscard]] const std::vector<lib_entry>& libraries() const noexcept { return m_libs; }
+
+    //-----------------------------------------------------------------------
+    // A library that couldn't be applied: one not found may appear later,
+    // unnoticed since not listed, so the manifest mustn't be saved.
+    // Empty elements instead depend just on the project stamp
+    void set_incomplete() noexcept { m_is_complete = false; }
+    [[nodiscard]] bool is_complete() const noexcept { return m_is_complete; }
+
+    //-----------------------------------------------------------------------
+    // To be called once the project is written
+    void set_project(const fs::path& prj_pth, const text::Enc enc)
+       {
+        m_prj_stamp = file_stamp_of(prj_pth);
+        m_enc = enc;
+       }
+
+    //-----------------------------------------------------------------------
+    void add_library(const fs::path& lib_pth, const std::string_view block)
+       {
+        m_libs.push_back( {fs::absolute(lib_pth), file_stamp_of(lib_pth), hash64(block)} );
+       }
+
+    //-----------------------------------------------------------------------
+    // The project is unchanged and so its libraries, telling by their
+    // stamps or, when these differ, by the hash of their converted block
+    // (the function gives it). The stamps are refreshed in that case,
+    // so the manifest is worth saving again just if is_refreshed()
+    template<typename F>
+    [[nodiscard]] bool is_up_to_date(const fs::path& prj_pth, F&& block_hash_of)
+       {
+        std::error_code ec;
+        if( not fs::exists(prj_pth, ec) or file_stamp_of(prj_pth)!=m_prj_stamp )
+           {
+            return false;
+           }
+        for( lib_entry& lib : m_libs )
+           {
+            if( not fs::exists(lib.path, ec) )
+               {
+                return false;
+               }
+            const file_stamp stamp = file_stamp_of(lib.path);
+            if( stamp!=lib.stamp )
+               {
+                if( block_hash_of(lib.path)!=lib.block_hash )
+                   {
+                    return false;
+                   }
+                lib.stamp = stamp;
+                m_is_refreshed = true;
+               }
+           }
+        return true;
+       }
+
+    [[nodiscard]] bool is_refreshed() const noexcept { return m_is_refreshed; }
+
+    //-----------------------------------------------------------------------
+    void save(const fs::path& pth) const
+       {
+        std::string s = fmt::format("llmanifest 1\nproject {} {} {}\n", m_prj_stamp.size, m_prj_stamp.mtime, static_cast<int>(m_enc));
+        for( const lib_entry& lib : m_libs )
+           {
+            s += fmt::format("lib {} {} {:016x} {}\n", lib.stamp.size, lib.stamp.mtime, lib.block_hash, lib.path.string());
+           }
+        sys::splice_writer out;
+        out.append_copy( std::move(s) );
+        out.write_to(pth);
+       }
+
+    //-----------------------------------------------------------------------
+    // Nothing if missing or not valid
+    [[nodiscard]] static std::optional<update_manifest> load(const fs::path& pth)
+       {
+        std::error_code ec;
+        if( fs::file_size(pth, ec)==0 or ec )
+           {
+            return std::nullopt;
+           }
+        try{
+            const sys::memory_mapped_file mapped{pth.string()};
+            std::string_view lines = mapped.as_string_view();
+            const auto next_line = [&lines]() -> std::string_view
+               {
+                const std::size_t eol = lines.find('\n');
+                const std::string_view line = lines.substr(0, eol);
+                lines.remove_prefix(eol==std::string_view::npos ? lines.size() : eol+1);
+                return line;
+               };
+
+            update_manifest manifest;
+            if( next_line()!="llmanifest 1" )
+               {
+                return std::nullopt;
+               }
+            std::string_view line = next_line();
+            int enc = 0;
+            if( not line.starts_with("project ") or
+                not parse_fields(line = line.substr(8), manifest.m_prj_stamp.size, manifest.m_prj_stamp.mtime, enc) or
+                not line.empty() or enc<0 or enc>static_cast<int>(text::Enc::UTF32BE) )
+               {
+                return std::nullopt;
+               }
+            manifest.m_enc = static_cast<text::Enc>(enc);
+            while( not lines.empty() )
+               {
+                line = next_line();
+                lib_entry lib;
+                if( not line.starts_with("lib ") or
+                    not parse_fields(line = line.substr(4), lib.stamp.size, lib.stamp.mtime, lib.block_hash, 16) or
+                    line.empty() )
+                   {
+                    return std::nullopt;
+                   }
+                lib.path = fs::path{line};
+                manifest.m_libs.push_back( std::move(lib) );
+               }
+            return manifest;
+           }
+        catch( std::exception& )
+           {
+            return std::nullopt;
+           }
+       }
+
+ private:
+    //-----------------------------------------------------------------------
+    // Space separated numbers, the line is left after them
+    template<typename T1, typename T2, typename T3>
+    [[nodiscard]] static bool parse_fields(std::string_view& line, T1& a, T2& b, T3& c, const int c_base =10) noexcept
+       {
+        return parse_field(line, a) and parse_field(line, b) and parse_field(line, c, c_base);
+       }
+
+    //-----------------------------------------------------------------------
+    template<typename T>
+    [[nodiscard]] static bool parse_field(std::string_view& line, T& val, const int base =10) noexcept
+       {
+        const auto [ptr, ec] = std::from_chars(line.data(), line.data()+line.size(), val, base);
+        if( ec!=std::errc() or (ptr<line.data()+line.size() and *ptr!=' ') )
+           {
+            return false;
+           }
+        line.remove_prefix( std::min(static_cast<std::size_t>(ptr - line.data()) + 1u, line.size()) );
+        return true;
+       }
+};
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"ll::update_manifest"> update_manifest_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+
+    ut::test("up to date") = []
+       {
+        const fs::path dir = fs::temp_directory_path() / "~llupdate-manifest-test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        const auto write_file = [](const fs::path& pth, const std::string_view content)
+           {
+            sys::splice_writer out;
+            out.append_ref(content);
+            out.write_to(pth);
+           };
+        const fs::path prj_pth = dir / "prj.plcprj";
+        const fs::path lib_pth = dir / "my lib.pll";
+        write_file(prj_pth, "<lib/>"sv);
+        write_file(lib_pth, "x := 1;"sv);
+
+        ll::update_manifest manifest;
+        manifest.add_library(lib_pth, "block"sv);
+        manifest.set_project(prj_pth, text::Enc::UTF16LE);
+        manifest.save( ll::update_manifest::path_of(prj_pth) );
+
+        std::optional<ll::update_manifest> loaded = ll::update_manifest::load( ll::update_manifest::path_of(prj_pth) );
+        expect( loaded.has_value() ) << "should be loaded\n";
+        if( loaded )
+           {
+            expect( loaded->encoding()==text::Enc::UTF16LE and loaded->libraries().size()==1u and loaded->libraries()[0].path==fs::absolute(lib_pth) );
+            std::size_t hashed = 0;
+            const auto block_hash_of = [&hashed](const fs::path&) { ++hashed; return ll::hash64("block"sv); };
+            expect( loaded->is_up_to_date(prj_pth, block_hash_of) and hashed==0u ) << "just stat calls\n";
+            expect( not loaded->is_refreshed() );
+
+            fs::last_write_time(lib_pth, fs::last_write_time(lib_pth) + std::chrono::seconds(10));
+            expect( loaded->is_up_to_date(prj_pth, block_hash_of) and hashed==1u ) << "touched library, same block\n";
+            expect( loaded->is_refreshed() );
+            expect( loaded->is_up_to_date(prj_pth, block_hash_of) and hashed==1u ) << "stamp should be refreshed\n";
+
+            fs::last_write_time(lib_pth, fs::last_write_time(lib_pth) + std::chrono::seconds(10));
+            expect( not loaded->is_up_to_date(prj_pth, [](const fs::path&) { return ll::hash64("changed"sv); }) );
+
+            write_file(prj_pth, "<lib>x</lib>"sv);
+            expect( not loaded->is_up_to_date(prj_pth, block_hash_of) ) << "project modified\n";
+           }
+
+        write_file(ll::update_manifest::path_of(prj_pth), "llmanifest 1\nproject 1 2\n"sv);
+        expect( not ll::update_manifest::load(ll::update_manifest::path_of(prj_pth)).has_value() );
+        expect( not ll::update_manifest::load(dir / "missing").has_value() );
+
+        fs::remove_all(dir);
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,223 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  Decoding of xml entities and character
+//  references (&lt; &#60; &#x3C;)
+//  ---------------------------------------------
+//  #include "xml-entities.hpp" // xml::decode_entities()
+//  ---------------------------------------------
+#include <array>
+#include <string>
+#include <string_view>
+
+#include "text.hpp" // text::Enc, text::append_codepoint<>()
+#include "text-scan.hpp" // text::find_any_of<>()
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace xml
+{
+
+//---------------------------------------------------------------------------
+// The codepoint of a reference between '&' and ';' (ex. "lt", "#60",
+// "#x3C"), text::null_codepoint if unknown or invalid
+[[nodiscard]] constexpr char32_t entity_codepoint(const std::u32string_view ref) noexcept
+{
+    if( ref==U"lt" ) return U'<';
+    if( ref==U"gt" ) return U'>';
+    if( ref==U"amp" ) return U'&';
+    if( ref==U"quot" ) return U'\"';
+    if( ref==U"apos" ) return U'\'';
+    if( ref.size()<2 or ref[0]!=U'#' )
+       {
+        return text::null_codepoint;
+       }
+
+    const bool hex = ref[1]==U'x';
+    const std::u32string_view digits = ref.substr(hex ? 2u : 1u);
+    if( digits.empty() )
+       {
+        return text::null_codepoint;
+       }
+    std::uint32_t val = 0;
+    for( const char32_t ch : digits )
+       {
+        std::uint32_t digit = 0;
+        if( ch>=U'0' and ch<=U'9' ) digit = ch - U'0';
+        else if( hex and ch>=U'a' and ch<=U'f' ) digit = 10u + (ch - U'a');
+        else if( hex and ch>=U'A' and ch<=U'F' ) digit = 10u + (ch - U'A');
+        else return text::null_codepoint;
+        val = (hex ? 16u : 10u) * val + digit;
+        if( val>0x10FFFF ) return text::null_codepoint;
+       }
+    if( val==0 or (val>=0xD800 and val<=0xDFFF) )
+       {// Not allowed
+        return text::null_codepoint;
+       }
+    return static_cast<char32_t>(val);
+}
+
+
+    namespace details
+       {
+        // Longest reference that could be valid: "#x10FFFF"
+        inline constexpr std::size_t max_reference_length = 8;
+
+        //-------------------------------------------------------------------
+        // The codepoint referenced after the '&' at amp_pos, also giving
+        // the units count up to ';' included
+        template<typename F>
+        [[nodiscard]] constexpr char32_t reference_at(F unit_at, const std::size_t units_count, const std::size_t amp_pos, std::size_t& ref_units) noexcept
+           {
+            std::array<char32_t, max_reference_length> ref_buf{};
+            std::size_t len = 0;
+            for( std::size_t i=amp_pos+1u; i<units_count and len<=max_reference_length; ++i, ++len )
+               {
+                const char32_t cu = unit_at(i);
+                if( cu==U';' )
+                   {
+                    ref_units = len + 2u; // '&' and ';'
+                    return entity_codepoint( std::u32string_view{ref_buf.data(), len} );
+                   }
+                if( len<max_reference_length ) ref_buf[len] = cu;
+               }
+            return text::null_codepoint;
+           }
+       }
+
+
+//---------------------------------------------------------------------------
+// Zero copy when there aren't references, otherwise the decoded value
+// is written in buf, in the same encoding. Unknown references are kept
+// std::string buf;
+// const std::string_view val = xml::decode_entities<enc>(raw_bytes, buf);
+template<text::Enc enc>
+[[nodiscard]] std::string_view decode_entities(const std::string_view raw, std::string& buf)
+{
+    constexpr std::size_t unit_size = text::code_unit_size<enc>;
+    std::size_t amp = text::find_any_of<enc,U'&'>(raw, 0);
+    if( amp==std::string_view::npos ) [[likely]]
+       {
+        return raw;
+       }
+
+    const auto unit_at = [raw](const std::size_t i) noexcept { return text::details::code_unit_at<enc>(raw.data() + i*unit_size); };
+    buf.clear();
+    std::size_t pos = 0;
+    while( amp!=std::string_view::npos )
+       {
+        buf.append(raw, pos, amp-pos);
+        std::size_t ref_units = 0;
+        const char32_t cp = details::reference_at(unit_at, raw.size()/unit_size, amp/unit_size, ref_units);
+        if( cp!=text::null_codepoint )
+           {
+            text::append_codepoint<enc>(cp, buf);
+            pos = amp + ref_units*unit_size;
+           }
+        else
+           {// Keep as it is
+            buf.append(raw, amp, unit_size);
+            pos = amp + unit_size;
+           }
+        amp = text::find_any_of<enc,U'&'>(raw, pos);
+       }
+    buf.append(raw, pos);
+    return buf;
+}
+
+
+//---------------------------------------------------------------------------
+// Same for already decoded strings (ex. ParserEvent::value())
+[[nodiscard]] inline std::u32string_view decode_entities(const std::u32string_view raw, std::u32string& buf)
+{
+    std::size_t amp = text::find_any_of<U'&'>(raw, 0);
+    if( amp==std::u32string_view::npos ) [[likely]]
+       {
+        return raw;
+       }
+
+    const auto unit_at = [raw](const std::size_t i) noexcept { return raw[i]; };
+    buf.clear();
+    std::size_t pos = 0;
+    while( amp!=std::u32string_view::npos )
+       {
+        buf.append(raw, pos, amp-pos);
+        std::size_t ref_units = 0;
+        const char32_t cp = details::reference_at(unit_at, raw.size(), amp, ref_units);
+        if( cp!=text::null_codepoint )
+           {
+            buf.push_back(cp);
+            pos = amp + ref_units;
+           }
+        else
+           {
+            buf.push_back(U'&');
+            pos = amp + 1u;
+           }
+        amp = text::find_any_of<U'&'>(raw, pos);
+       }
+    buf.append(raw, pos);
+    return buf;
+}
+
+//---------------------------------------------------------------------------
+[[nodiscard]] inline std::u32string decode_entities(const std::u32string_view raw)
+{
+    std::u32string buf;
+    return std::u32string{decode_entities(raw, buf)};
+}
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"xml::decode_entities()"> xml_entities_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+
+    ut::test("entity_codepoint()") = []
+       {
+        expect( xml::entity_codepoint(U"lt")==U'<' and xml::entity_codepoint(U"apos")==U'\'' );
+        expect( xml::entity_codepoint(U"#60")==U'<' and xml::entity_codepoint(U"#x3C")==U'<' and xml::entity_codepoint(U"#x3c")==U'<' );
+        expect( xml::entity_codepoint(U"#x10FFFF")==U'\U0010FFFF' );
+        expect( xml::entity_codepoint(U"nbsp")==text::null_codepoint and xml::entity_codepoint(U"#")==text::null_codepoint );
+        expect( xml::entity_codepoint(U"#x110000")==text::null_codepoint and xml::entity_codepoint(U"#xD800")==text::null_codepoint );
+        expect( xml::entity_codepoint(U"#0")==text::null_codepoint and xml::entity_codepoint(U"#1a")==text::null_codepoint );
+       };
+
+    ut::test("utf-32 strings") = []
+       {
+        std::u32string buf;
+        const std::u32string_view plain = U"no references here";
+        expect( xml::decode_entities(plain, buf).data()==plain.data() ) << "shouldn't copy\n";
+        expect( xml::decode_entities(U"1&lt;2 &amp;&amp; &quot;x&quot;"sv, buf)==U"1<2 && \"x\""sv );
+        expect( xml::decode_entities(U"&#x27F6;&#10230;"sv, buf)==U"⟶⟶"sv );
+        expect( xml::decode_entities(U"a & b &unknown; &lt"sv, buf)==U"a & b &unknown; &lt"sv ) << "invalid references should be kept\n";
+        expect( xml::decode_entities(U"&#x00000000003C;"sv)==U"&#x00000000003C;"sv );
+       };
+
+    ut::test("encoded bytes") = []
+       {
+        const std::u32string raw = U"à&lt;è&#x27F6;&bad;&"s;
+        const std::u32string decoded = U"à<è⟶&bad;&"s;
+        const auto test_enc = [&]<text::Enc ENC>() -> void
+           {
+            std::string buf;
+            const std::string raw_bytes = text::to<ENC>(raw);
+            expect( xml::decode_entities<ENC>(raw_bytes, buf)==text::to<ENC>(decoded) );
+            const std::string plain = text::to<ENC>(U"àèìòù"sv);
+            expect( xml::decode_entities<ENC>(plain, buf).data()==plain.data() ) << "shouldn't copy\n";
+           };
+        test_enc.template operator()<text::Enc::UTF8>();
+        test_enc.template operator()<text::Enc::UTF16LE>();
+        test_enc.template operator()<text::Enc::UTF16BE>();
+        test_enc.template operator()<text::Enc::UTF32LE>();
+        test_enc.template operator()<text::Enc::UTF32BE>();
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,279 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  Lazy processing stages over the events of
+//  an xml parser, chained as coroutines
+//  ---------------------------------------------
+//  #include "xml-pipeline.hpp" // xml::events_of(), xml::filter_by_path(), ...
+//  ---------------------------------------------
+#include <algorithm> // std::ranges::equal, std::ranges::find
+#include <span>
+#include <vector>
+#include <string>
+#include <string_view>
+
+#include "generator.hpp" // MG::generator<>
+#include "parser-xml.hpp" // xml::Parser, xml::ParserEvent
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace xml
+{
+using EventsStream = MG::generator<const ParserEvent&>;
+
+// The events are processed one at a time, nothing is materialized:
+// for( std::string_view s : xml::serialize<enc>(xml::filter_by_path(xml::events_of<enc>(bytes), path)) ) out += s;
+
+
+//---------------------------------------------------------------------------
+// The source of a pipeline, bytes must outlive the stream
+template<text::Enc enc>
+[[nodiscard]] EventsStream events_of(const std::string_view bytes, const typename Parser<enc>::Options options ={}, const Engine engine =Engine::CODEPOINT)
+{
+    Parser<enc> parser{bytes, engine};
+    parser.options() = options;
+    while( const ParserEvent& event = parser.next_event() )
+       {
+        co_yield event;
+       }
+}
+
+
+//---------------------------------------------------------------------------
+// Just the events inside the elements with the given path, ex.
+// {U"plcProject", U"libraries", U"lib"}, their tags included
+[[nodiscard]] inline EventsStream filter_by_path(EventsStream events, const std::vector<std::u32string> path)
+{
+    std::vector<std::u32string> open_elements;
+    const auto is_inside = [&path, &open_elements]() noexcept -> bool
+       {
+        return open_elements.size()>=path.size() and std::ranges::equal(path, std::span{open_elements.data(), path.size()});
+       };
+
+    for( const ParserEvent& event : events )
+       {
+        if( event.is_open_tag() )
+           {
+            open_elements.push_back( event.value() );
+            if( is_inside() ) co_yield event;
+           }
+        else if( event.is_close_tag() )
+           {
+            if( is_inside() ) co_yield event;
+            if( not open_elements.empty() ) open_elements.pop_back();
+           }
+        else if( is_inside() )
+           {
+            co_yield event;
+           }
+       }
+}
+
+
+//---------------------------------------------------------------------------
+// Open tags keeping only the given attributes
+[[nodiscard]] inline EventsStream project_attributes(EventsStream events, const std::vector<std::u32string> names)
+{
+    ParserEvent projected;
+    for( const ParserEvent& event : events )
+       {
+        if( event.is_open_tag() )
+           {
+            projected = event;
+            projected.attributes().erase_if([&names](const auto it) { return std::ranges::find(names, it->first)==names.end(); });
+            co_yield projected;
+           }
+        else
+           {
+            co_yield event;
+           }
+       }
+}
+
+
+    namespace details
+       {
+        //-------------------------------------------------------------------
+        template<text::Enc enc> void append_encoded(const std::u32string_view s, std::string& out)
+           {
+            for( const char32_t cp : s ) text::append_codepoint<enc>(cp, out);
+           }
+
+        //-------------------------------------------------------------------
+        // Text chunks are still in the encoding of the parsed buffer
+        template<text::Enc src_enc, text::Enc enc> void append_reencoded(const std::string_view bytes, std::string& out)
+           {
+            if constexpr( src_enc==enc )
+               {
+                out += bytes;
+               }
+            else
+               {
+                text::buffer_t<src_enc> bytes_buf(bytes);
+                while( bytes_buf.has_codepoint() ) text::append_codepoint<enc>(bytes_buf.extract_codepoint(), out);
+               }
+           }
+
+        //-------------------------------------------------------------------
+        // A value between double quotes, that may come from a single
+        // quoted one
+        template<text::Enc enc> void append_attribute_value(const std::u32string_view val, std::string& out)
+           {
+            for( const char32_t cp : val )
+               {
+                if( cp==U'\"' ) append_encoded<enc>(U"&quot;", out);
+                else text::append_codepoint<enc>(cp, out);
+               }
+           }
+       }
+
+//---------------------------------------------------------------------------
+// The markup of the events in the given encoding, one fragment for each.
+// Values are written as collected (entities aren't decoded by the
+// parser), CDATA sections are written back as such, also when given in
+// chunks, that are re-encoded from src_enc (the one of the parser).
+// Empty elements are written as open and close
+template<text::Enc enc, text::Enc src_enc =enc>
+[[nodiscard]] MG::generator<std::string_view> serialize(EventsStream events)
+{
+    std::string buf;
+    bool in_cdata_chunks = false;
+    for( const ParserEvent& event : events )
+       {
+        buf.clear();
+        if( event.is_open_tag() )
+           {
+            details::append_encoded<enc>(U"<", buf);
+            details::append_encoded<enc>(event.value(), buf);
+            for( const auto& [nam, val] : event.attributes() )
+               {
+                details::append_encoded<enc>(U" ", buf);
+                details::append_encoded<enc>(nam, buf);
+                if( val.has_value() )
+                   {
+                    details::append_encoded<enc>(U"=\"", buf);
+                    details::append_attribute_value<enc>(*val, buf);
+                    details::append_encoded<enc>(U"\"", buf);
+                   }
+               }
+            details::append_encoded<enc>(U">", buf);
+           }
+        else if( event.is_close_tag() )
+           {
+            details::append_encoded<enc>(U"</", buf);
+            details::append_encoded<enc>(event.value(), buf);
+            details::append_encoded<enc>(U">", buf);
+           }
+        else if( event.is_text() )
+           {
+            if( event.is_cdata() ) details::append_encoded<enc>(U"<![CDATA[", buf);
+            details::append_encoded<enc>(event.value(), buf);
+            if( event.is_cdata() ) details::append_encoded<enc>(U"]]>", buf);
+           }
+        else if( event.is_text_chunk() )
+           {
+            if( event.is_cdata() and not in_cdata_chunks )
+               {
+                details::append_encoded<enc>(U"<![CDATA[", buf);
+                in_cdata_chunks = true;
+               }
+            details::append_reencoded<src_enc,enc>(event.chunk_bytes(), buf);
+            if( event.is_last_chunk() and in_cdata_chunks )
+               {
+                details::append_encoded<enc>(U"]]>", buf);
+                in_cdata_chunks = false;
+               }
+           }
+        else if( event.is_comment() )
+           {
+            details::append_encoded<enc>(U"<!--", buf);
+            details::append_encoded<enc>(event.value(), buf);
+            details::append_encoded<enc>(U"-->", buf);
+           }
+        else if( event.is_special_block() )
+           {
+            details::append_encoded<enc>(U"<!", buf);
+            details::append_encoded<enc>(event.value(), buf);
+            details::append_encoded<enc>(U">", buf);
+           }
+        // Processing instructions content isn't collected
+        if( not buf.empty() )
+           {
+            co_yield std::string_view{buf};
+           }
+       }
+}
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"xml::pipeline"> xml_pipeline_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+    using ut::throws;
+
+    const std::string_view buf = "<?xml version=\"1.0\"?>\n"
+                                 "<prj name=\"p\">\n"
+                                 "  <libs>\n"
+                                 "    <lib name=\"a.pll\" link=\"true\" version=\"1\"/>\n"
+                                 "    <lib name=\"b.pll\" link=\"false\"><!-- b --><![CDATA[x<y]]></lib>\n"
+                                 "  </libs>\n"
+                                 "  <lib name=\"c.pll\"/>\n"
+                                 "</prj>\n";
+
+    xml::Parser<text::Enc::UTF8>::Options options;
+    options.set_collect_comment_text(true);
+    options.set_collect_text_sections(true);
+
+    ut::test("stages") = [buf, options]
+       {
+        std::size_t n = 0;
+        for( const xml::ParserEvent& event : xml::filter_by_path(xml::events_of<text::Enc::UTF8>(buf, options), {U"prj", U"libs", U"lib"}) )
+           {
+            expect( event.is_open_tag(U"lib") or event.is_close_tag(U"lib") or event.is_comment() or event.is_text() );
+            ++n;
+           }
+        expect( that % n==6u ) << "c.pll isn't in the path\n";
+
+        for( const xml::ParserEvent& event : xml::project_attributes(xml::events_of<text::Enc::UTF8>(buf, options), {U"name"}) )
+           {
+            if( event.is_open_tag(U"lib") ) expect( that % event.attributes().size()==1u and event.attributes().contains(U"name") );
+           }
+       };
+
+    ut::test("serialize") = [buf, options]
+       {
+        std::string out;
+        for( const std::string_view s : xml::serialize<text::Enc::UTF8>(xml::project_attributes(xml::filter_by_path(xml::events_of<text::Enc::UTF8>(buf, options), {U"prj", U"libs"}), {U"name"})) )
+           {
+            out += s;
+           }
+        expect( that % out=="<libs><lib name=\"a.pll\"></lib><lib name=\"b.pll\"><!-- b --><![CDATA[x<y]]></lib></libs>"sv );
+
+        std::string out16;
+        for( const std::string_view s : xml::serialize<text::Enc::UTF16BE>(xml::events_of<text::Enc::UTF8>("<a x=\"à\">è</a>"sv)) ) out16 += s;
+        expect( out16==text::to<text::Enc::UTF16BE>(U"<a x=\"à\"></a>"sv) ) << "texts aren't collected by default\n";
+
+        const auto serialized = []<text::Enc ENC>(const std::string_view bytes, const xml::Parser<text::Enc::UTF8>::Options& opts) -> std::string
+           {
+            std::string s;
+            for( const std::string_view frag : xml::serialize<ENC,text::Enc::UTF8>(xml::events_of<text::Enc::UTF8>(bytes, opts)) ) s += frag;
+            return s;
+           };
+        const std::string_view cdata = "<a><![CDATA[a&b]]><![CDATA[&lt;]]><![CDATA[]]><b x='say \"hi\"'>t &amp; u</b></a>"sv;
+        expect( that % serialized.template operator()<text::Enc::UTF8>(cdata, options)=="<a><![CDATA[a&b]]><![CDATA[&lt;]]><![CDATA[]]><b x=\"say &quot;hi&quot;\">t &amp; u</b></a>"sv );
+        xml::Parser<text::Enc::UTF8>::Options chunked;
+        chunked.set_text_chunk_bytes(2);
+        expect( serialized.template operator()<text::Enc::UTF16BE>(cdata, chunked)==text::to<text::Enc::UTF16BE>(U"<a><![CDATA[a&b]]><![CDATA[&lt;]]><![CDATA[]]><b x=\"say &quot;hi&quot;\">t &amp; u</b></a>"sv) ) << "chunks should be re-encoded\n";
+
+        const auto broken = [options]{ for( [[maybe_unused]] const std::string_view s : xml::serialize<text::Enc::UTF8>(xml::events_of<text::Enc::UTF8>("<a><b x=\"1></b></a>"sv, options)) ) ; };
+        expect( throws<text::parse_error>(broken) ) << "parse errors should reach the consumer\n";
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,462 @@
+﻿#pragma once
+//  ---------------------------------------------
+//  A flat read only xml document built in one
+//  pass from the events of a parser
+//  ---------------------------------------------
+//  #include "xml-tape.hpp" // xml::Tape, xml::build_tape()
+//  ---------------------------------------------
+#include <cstdint> // std::uint32_t
+#include <limits> // std::numeric_limits
+#include <optional>
+#include <span>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <type_traits> // std::integral_constant
+#include <stdexcept> // std::runtime_error
+#include <fmt/core.h> // fmt::format
+
+#include "parser-xml.hpp" // xml::ParserEvent, xml::ByteSpan, xml::NameTable
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace xml
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// Nodes and attributes in contiguous vectors linked by indexes,
+// names interned as symbols, collected strings held in an arena.
+// Attribute values are just spans decoded on access, so the parsed
+// buffer must outlive the tape.
+// The node 0 is the document, parent of the top level nodes
+class Tape final
+{
+ public:
+    using node_index_t = std::uint32_t;
+    using symbol_t = std::uint32_t;
+    static constexpr node_index_t null_node = std::numeric_limits<node_index_t>::max();
+    static constexpr symbol_t no_symbol = std::numeric_limits<symbol_t>::max();
+    static constexpr node_index_t document = 0;
+
+    enum class NodeType : std::uint8_t
+       {
+        DOCUMENT =0
+       ,ELEMENT // <tag attr1 attr2=val>...</tag>
+       ,TEXT // >...< or CDATA
+       ,COMMENT // <!-- ... -->
+       ,PROCINST // <? ... ?>
+       ,SPECIALBLOCK // <!xxx ... >
+       };
+
+    struct ArenaSpan final
+       {
+        std::uint32_t start = 0;
+        std::uint32_t length = 0;
+       };
+
+    struct Attribute final
+       {
+        symbol_t name = no_symbol;
+        std::optional<ByteSpan> value; // In the parsed buffer
+       };
+
+    struct Node final
+       {
+        NodeType type = NodeType::DOCUMENT;
+        symbol_t name = no_symbol; // Elements only
+        ByteSpan span; // Elements: from open tag start to close tag end
+        node_index_t parent = null_node;
+        node_index_t first_child = null_node;
+        node_index_t next_sibling = null_node;
+        std::uint32_t first_attribute = 0;
+        std::uint32_t attributes_count = 0;
+        ArenaSpan value; // Collected content of text and comments
+       };
+
+    /////////////////////////////////////////////////////////////////////////
+    class children_range final
+       {
+        public:
+            class iterator final
+               {
+                private:
+                    const Tape* m_tape;
+                    node_index_t m_node;
+                public:
+                    using value_type = node_index_t;
+                    using difference_type = std::ptrdiff_t;
+                    constexpr iterator() noexcept : m_tape(nullptr), m_node(null_node) {}
+                    constexpr iterator(const Tape* const tape, const node_index_t node) noexcept : m_tape(tape), m_node(node) {}
+                    [[nodiscard]] constexpr node_index_t operator*() const noexcept { return m_node; }
+                    constexpr iterator& operator++() noexcept { m_node = m_tape->node(m_node).next_sibling; return *this; }
+                    constexpr iterator operator++(int) noexcept { iterator tmp = *this; ++*this; return tmp; }
+                    [[nodiscard]] constexpr bool operator==(const iterator& other) const noexcept { return m_node==other.m_node; }
+               };
+        private:
+            const Tape* m_tape;
+            node_index_t m_first;
+        public:
+            constexpr children_range(const Tape* const tape, const node_index_t first) noexcept : m_tape(tape), m_first(first) {}
+            [[nodiscard]] constexpr iterator begin() const noexcept { return {m_tape, m_first}; }
+            [[nodiscard]] constexpr iterator end() const noexcept { return {m_tape, null_node}; }
+       };
+
+ private:
+    std::vector<Node> m_nodes;
+    std::vector<Attribute> m_attributes;
+    NameTable m_symbols; // Ids are the symbols
+    std::u32string m_arena;
+    std::string_view m_bytes; // The parsed buffer
+    std::u32string (*m_decode)(const std::string_view) = nullptr; // From its encoding
+
+ public:
+    Tape()
+       {
+        m_nodes.emplace_back(); // The document
+       }
+
+    [[nodiscard]] constexpr std::size_t nodes_count() const noexcept { return m_nodes.size(); }
+    [[nodiscard]] constexpr Node const& node(const node_index_t i) const noexcept { return m_nodes[i]; }
+    [[nodiscard]] constexpr children_range children(const node_index_t i) const noexcept { return {this, m_nodes[i].first_child}; }
+
+    [[nodiscard]] constexpr bool is_element(const node_index_t i, const symbol_t name) const noexcept
+       {
+        return m_nodes[i].type==NodeType::ELEMENT and m_nodes[i].name==name;
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] std::u32string_view name_of(const symbol_t sym) const noexcept
+       {
+        return sym<m_symbols.size() ? m_symbols.name_of(sym) : std::u32string_view{};
+       }
+    [[nodiscard]] std::u32string_view name(const node_index_t i) const noexcept { return name_of(m_nodes[i].name); }
+
+    //-----------------------------------------------------------------------
+    // The symbol of a name, no_symbol if not present in the document
+    [[nodiscard]] symbol_t symbol_of(const std::u32string_view nam) const noexcept
+       {
+        return m_symbols.find(nam).value_or(no_symbol);
+       }
+
+    //-----------------------------------------------------------------------
+    // The collected content of a text or comment node
+    [[nodiscard]] constexpr std::u32string_view value(const node_index_t i) const noexcept { return arena_view(m_nodes[i].value); }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] constexpr std::span<const Attribute> attributes(const node_index_t i) const noexcept
+       {
+        return std::span<const Attribute>{m_attributes}.subspan(m_nodes[i].first_attribute, m_nodes[i].attributes_count);
+       }
+
+    //-----------------------------------------------------------------------
+    // The bytes of an attribute value in the parsed buffer,
+    // entity references not resolved
+    [[nodiscard]] constexpr std::optional<std::string_view> attribute_value_bytes(const node_index_t i, const symbol_t nam) const noexcept
+       {
+        for( const Attribute& attr : attributes(i) )
+           {
+            if( attr.name==nam and attr.value.has_value() )
+               {
+                return attr.value->bytes_of(m_bytes);
+               }
+           }
+        return std::nullopt;
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] std::optional<std::u32string> attribute_value(const node_index_t i, const symbol_t nam) const
+       {
+        if( const auto val_bytes = attribute_value_bytes(i, nam) )
+           {
+            return m_decode(*val_bytes);
+           }
+        return std::nullopt;
+       }
+    [[nodiscard]] std::optional<std::u32string> attribute_value(const node_index_t i, const std::u32string_view nam) const
+       {
+        return attribute_value(i, symbol_of(nam));
+       }
+
+    //-----------------------------------------------------------------------
+    // The bytes of the whole subtree in the original buffer
+    [[nodiscard]] constexpr ByteSpan byte_span(const node_index_t i) const noexcept { return m_nodes[i].span; }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] constexpr node_index_t find_child(const node_index_t i, const symbol_t nam) const noexcept
+       {
+        for( const node_index_t child : children(i) )
+           {
+            if( is_element(child, nam) ) return child;
+           }
+        return null_node;
+       }
+
+    //-----------------------------------------------------------------------
+    [[nodiscard]] constexpr node_index_t find_next_sibling(const node_index_t i, const symbol_t nam) const noexcept
+       {
+        node_index_t sibling = m_nodes[i].next_sibling;
+        while( sibling!=null_node and not is_element(sibling, nam) ) sibling = m_nodes[sibling].next_sibling;
+        return sibling;
+       }
+
+    //-----------------------------------------------------------------------
+    // Elements in the subtree of a node, nodes are stored in document
+    // order so a subtree is a contiguous range
+    [[nodiscard]] constexpr std::size_t count_elements(const symbol_t nam, const node_index_t i =document) const noexcept
+       {
+        std::size_t count = 0;
+        const node_index_t last = subtree_end(i);
+        for( node_index_t j=i+1u; j<last; ++j )
+           {
+            if( is_element(j, nam) ) ++count;
+           }
+        return count;
+       }
+
+    //-----------------------------------------------------------------------
+    // One past the last node of the subtree
+    [[nodiscard]] constexpr node_index_t subtree_end(node_index_t i) const noexcept
+       {
+        while( i!=null_node and m_nodes[i].next_sibling==null_node ) i = m_nodes[i].parent;
+        return i==null_node ? static_cast<node_index_t>(m_nodes.size()) : m_nodes[i].next_sibling;
+       }
+
+
+    /////////////////////////////////////////////////////////////////////////
+    // Appends the nodes while consuming the events of the parser
+    // of the given buffer, needs the attributes spans (not lazy)
+    class Builder final
+       {
+        private:
+            Tape& m_tape;
+            std::vector<node_index_t> m_open; // Open elements
+            std::vector<node_index_t> m_last_child; // Of each open element
+
+        public:
+            template<text::Enc enc>
+            Builder(Tape& tape, const std::string_view bytes, std::integral_constant<text::Enc,enc>)
+              : m_tape(tape)
+              , m_open{document}
+              , m_last_child{null_node}
+               {
+                m_tape.m_bytes = bytes;
+                m_tape.m_decode = &text::to_utf32<enc>;
+               }
+
+            [[nodiscard]] constexpr bool has_open_elements() const noexcept { return m_open.size()>1u; }
+            [[nodiscard]] std::u32string_view innermost_open_element() const noexcept { return m_tape.name(m_open.back()); }
+
+            void on_event(const ParserEvent& event)
+               {
+                if( event.is_open_tag() )
+                   {
+                    const node_index_t i = append_node(NodeType::ELEMENT, event);
+                    Node& nod = m_tape.m_nodes[i];
+                    nod.name = m_tape.intern(event.value());
+                    nod.first_attribute = static_cast<std::uint32_t>(m_tape.m_attributes.size());
+                    nod.attributes_count = static_cast<std::uint32_t>(event.attributes_spans().size());
+                    for( const AttributeSpan& attr_span : event.attributes_spans() )
+                       {
+                        Attribute& attr = m_tape.m_attributes.emplace_back();
+                        attr.name = m_tape.intern( m_tape.m_decode(attr_span.name.bytes_of(m_tape.m_bytes)) );
+                        attr.value = attr_span.value;
+                       }
+                    m_open.push_back(i);
+                    m_last_child.push_back(null_node);
+                   }
+                else if( event.is_close_tag() )
+                   {
+                    if( not has_open_elements() or m_tape.name(m_open.back())!=event.value() )
+                       {
+                        throw std::runtime_error( fmt::format("Unmatched close tag `{}`", text::to_utf8(event.value())) );
+                       }
+                    m_tape.m_nodes[m_open.back()].span.end = event.end_byte_offset();
+                    m_open.pop_back();
+                    m_last_child.pop_back();
+                   }
+                else if( event.is_text() )
+                   {
+                    m_tape.m_nodes[append_node(NodeType::TEXT, event)].value = m_tape.store(event.value());
+                   }
+                else if( event.is_comment() )
+                   {
+                    m_tape.m_nodes[append_node(NodeType::COMMENT, event)].value = m_tape.store(event.value());
+                   }
+                else if( event.is_proc_instr() )
+                   {
+                    [[maybe_unused]] const node_index_t i = append_node(NodeType::PROCINST, event);
+                   }
+                else if( event.is_special_block() )
+                   {
+                    m_tape.m_nodes[append_node(NodeType::SPECIALBLOCK, event)].value = m_tape.store(event.value());
+                   }
+               }
+
+            void on_end(const std::size_t end_byte_offset)
+               {
+                if( has_open_elements() )
+                   {
+                    throw std::runtime_error( fmt::format("Unclosed tag `{}`", text::to_utf8(innermost_open_element())) );
+                   }
+                m_tape.m_nodes[document].span.end = end_byte_offset;
+               }
+
+        private:
+            [[nodiscard]] node_index_t append_node(const NodeType type, const ParserEvent& event)
+               {
+                const node_index_t i = static_cast<node_index_t>(m_tape.m_nodes.size());
+                Node& nod = m_tape.m_nodes.emplace_back();
+                nod.type = type;
+                nod.span = event.byte_span();
+                nod.parent = m_open.back();
+                if( m_last_child.back()==null_node )
+                   {
+                    m_tape.m_nodes[nod.parent].first_child = i;
+                   }
+                else
+                   {
+                    m_tape.m_nodes[m_last_child.back()].next_sibling = i;
+                   }
+                m_last_child.back() = i;
+                return i;
+               }
+       };
+
+ private:
+    [[nodiscard]] constexpr std::u32string_view arena_view(const ArenaSpan sp) const noexcept
+       {
+        return std::u32string_view{m_arena}.substr(sp.start, sp.length);
+       }
+
+    [[nodiscard]] symbol_t intern(const std::u32string_view nam)
+       {
+        return m_symbols.intern(nam);
+       }
+
+    [[nodiscard]] ArenaSpan store(const std::u32string_view s)
+       {
+        if( s.size() > std::numeric_limits<std::uint32_t>::max() - m_arena.size() )
+           {
+            throw std::runtime_error( fmt::format("Collected text exceeds the tape capacity ({} chars)", std::numeric_limits<std::uint32_t>::max()) );
+           }
+        const ArenaSpan sp{static_cast<std::uint32_t>(m_arena.size()), static_cast<std::uint32_t>(s.size())};
+        m_arena += s;
+        return sp;
+       }
+};
+
+
+//---------------------------------------------------------------------------
+// Consume all the events of a parser (xml::Parser or xml::ParallelParser),
+// the attributes may be not collected since just their spans are used
+// xml::Parser<enc> parser{bytes};
+// const xml::Tape tape = xml::build_tape(parser);
+template<template<text::Enc> class PARSER, text::Enc enc>
+[[nodiscard]] Tape build_tape(PARSER<enc>& parser)
+{
+    Tape tape;
+    Tape::Builder builder{tape, parser.bytes(), std::integral_constant<text::Enc,enc>{}};
+    try{
+        while( const ParserEvent& event = parser.next_event() )
+           {
+            builder.on_event(event);
+           }
+        builder.on_end(parser.curr_event().end_byte_offset());
+       }
+    catch(text::parse_error&)
+       {
+        throw;
+       }
+    catch(std::runtime_error& e)
+       {
+        throw text::parse_error(e.what(), parser.curr_line());
+       }
+    return tape;
+}
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+#ifdef TEST_UNITS ///////////////////////////////////////////////////////////
+static ut::suite<"xml::Tape"> xml_tape_tests = []
+{////////////////////////////////////////////////////////////////////////////
+    using namespace std::literals; // "..."sv
+    using ut::expect;
+    using ut::that;
+    using ut::throws;
+
+    const std::string_view buf =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+        "<plcProject name=\"prj\">\n"
+        "  <libraries>\n"
+        "    <lib name=\"a.pll\" link=\"true\">\n"
+        "      <pou name=\"FB1\"/>\n"
+        "      <!-- second -->\n"
+        "      <pou name=\"FB2\"><src><![CDATA[x<y]]></src></pou>\n"
+        "    </lib>\n"
+        "    <lib name=\"b.pll\" nolink>\n"
+        "      <pou name=\"FB3\"/>\n"
+        "    </lib>\n"
+        "  </libraries>\n"
+        "</plcProject>\n"sv;
+
+    ut::test("structure") = [buf]
+       {
+        xml::Parser<text::Enc::UTF8> parser{buf};
+        parser.options().set_collect_comment_text(true);
+        parser.options().set_collect_text_sections(true);
+        parser.options().set_collect_attributes(false);
+        const xml::Tape tape = xml::build_tape(parser);
+        expect( that % tape.nodes_count()==12u );
+
+        const xml::Tape::symbol_t lib = tape.symbol_of(U"lib");
+        const xml::Tape::symbol_t pou = tape.symbol_of(U"pou");
+        expect( lib!=xml::Tape::no_symbol and pou!=xml::Tape::no_symbol );
+        expect( that % tape.symbol_of(U"none")==xml::Tape::no_symbol );
+        expect( that % tape.count_elements(pou)==3u );
+
+        const auto prj = tape.find_child(xml::Tape::document, tape.symbol_of(U"plcProject"));
+        const auto libs = tape.find_child(prj, tape.symbol_of(U"libraries"));
+        const auto lib1 = tape.find_child(libs, lib);
+        const auto lib2 = tape.find_next_sibling(lib1, lib);
+        expect( lib2!=xml::Tape::null_node and tape.find_next_sibling(lib2, lib)==xml::Tape::null_node );
+        expect( tape.attribute_value(lib1, U"name")==U"a.pll"sv and tape.attribute_value(lib2, U"name")==U"b.pll"sv );
+        expect( not tape.attribute_value(lib2, U"nolink").has_value() and tape.attributes(lib2).size()==2u );
+        expect( tape.attribute_value_bytes(lib1, tape.symbol_of(U"link"))=="true"sv and not tape.attribute_value_bytes(lib1, tape.symbol_of(U"none")) );
+        expect( that % tape.count_elements(pou, lib1)==2u and tape.count_elements(pou, lib2)==1u );
+        expect( tape.node(lib1).parent==libs );
+
+        std::vector<xml::Tape::NodeType> types;
+        for( const auto child : tape.children(lib1) ) types.push_back( tape.node(child).type );
+        expect( types==std::vector{xml::Tape::NodeType::ELEMENT, xml::Tape::NodeType::COMMENT, xml::Tape::NodeType::ELEMENT} );
+
+        expect( that % tape.byte_span(lib2).bytes_of(buf)=="<lib name=\"b.pll\" nolink>\n      <pou name=\"FB3\"/>\n    </lib>"sv );
+        expect( that % tape.byte_span(tape.find_child(lib2, pou)).bytes_of(buf)=="<pou name=\"FB3\"/>"sv );
+        const auto src = tape.find_child(tape.find_next_sibling(tape.find_child(lib1, pou), pou), tape.symbol_of(U"src"));
+        expect( tape.value(tape.node(src).first_child)==U"x<y"sv );
+        expect( that % tape.byte_span(xml::Tape::document).end==buf.size() );
+       };
+
+    ut::test("attributes in other encodings") = []
+       {
+        const std::string bytes = text::to<text::Enc::UTF16BE>(U"<a x='à&amp;b' y/>"sv);
+        xml::Parser<text::Enc::UTF16BE> parser{bytes};
+        const xml::Tape tape = xml::build_tape(parser);
+        const auto a = tape.find_child(xml::Tape::document, tape.symbol_of(U"a"));
+        expect( tape.attribute_value(a, U"x")==U"à&amp;b"sv ) << "decoded but entities not resolved\n";
+        expect( tape.attributes(a).size()==2u and not tape.attribute_value(a, U"y") );
+       };
+
+    ut::test("errors") = []
+       {
+        const auto build = [](const std::string_view bytes) { xml::Parser<text::Enc::UTF8> parser{bytes}; [[maybe_unused]] auto tape = xml::build_tape(parser); };
+        expect( throws<text::parse_error>([&build]{ build("<a>\n<b></a>"sv); }) ) << "unmatched close tag should throw\n";
+        expect( throws<text::parse_error>([&build]{ build("<a>\n<b></b>"sv); }) ) << "unclosed tag should throw\n";
+        expect( throws<text::parse_error>([&build]{ build("</a>"sv); }) ) << "close tag without open should throw\n";
+       };
+};///////////////////////////////////////////////////////////////////////////
+#endif // TEST_UNITS ////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
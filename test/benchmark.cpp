@@ -0,0 +1,225 @@
+﻿//  ---------------------------------------------
+//  Benchmarks of the xml parser engines
+//  Usage: llupdate-benchmark [project files...]
+//  (a synthetic project is used if none given)
+//  ---------------------------------------------
+#include <chrono>
+#include <string>
+#include <string_view>
+using namespace std::literals; // "..."sv
+#include <vector>
+#include <fmt/core.h> // fmt::*
+
+#include "memory_mapped_file.hpp" // sys::memory_mapped_file
+#include "parser-xml.hpp" // xml::Parser
+#include "parser-xml-parallel.hpp" // xml::ParallelParser
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+namespace bench
+{
+
+//---------------------------------------------------------------------------
+// Something resembling a big LogicLab project
+[[nodiscard]] std::string synthetic_project(const std::size_t libs_count)
+{
+    std::string st_code;
+    for( int k=0; k<10; ++k )
+       {
+        st_code += "IF x<10 AND y THEN\n"
+                   "    x := x + 1; (* it's a \"counter\" *)\n"
+                   "ELSIF x>100 THEN\n"
+                   "    x := 0;\n"
+                   "END_IF;\n";
+       }
+    std::string s = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                    "<plcProject name=\"synthetic\" version=\"1.0\">\n"
+                    "  <libraries>\n";
+    for( std::size_t i=0; i<libs_count; ++i )
+       {
+        s += fmt::format("    <lib link=\"true\" name=\"C:\\libs\\lib{0}.pll\" version=\"{0}.0\">\n", i);
+        for( std::size_t j=0; j<20; ++j )
+           {
+            s += fmt::format("      <pou name=\"FB_{0}_{1}\" type=\"functionBlock\" language=\"ST\">\n"
+                             "        <!-- Function block {0}.{1} -->\n"
+                             "        <vars><var name=\"x\" type=\"INT\"/><var name=\"y\" type=\"BOOL\"/></vars>\n"
+                             "        <sourceCode><![CDATA[\n"
+                             "{2}"
+                             "        ]]></sourceCode>\n"
+                             "      </pou>\n", i, j, st_code);
+           }
+        s += "    </lib>\n";
+       }
+    s += "  </libraries>\n"
+         "</plcProject>\n";
+    return s;
+}
+
+//---------------------------------------------------------------------------
+// Best of some runs, in seconds
+template<typename F> [[nodiscard]] double best_time_of(F&& f, const int runs =5)
+{
+    double best = 1E100;
+    for( int i=0; i<runs; ++i )
+       {
+        const auto t0 = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+        if( dt.count()<best ) best = dt.count();
+       }
+    return best;
+}
+
+//---------------------------------------------------------------------------
+template<text::Enc enc> [[nodiscard]] std::size_t count_events(const std::string_view bytes, const xml::Engine engine, const bool check_nesting =false)
+{
+    xml::Parser<enc> parser{bytes, engine};
+    parser.options().set_check_nesting(check_nesting);
+    std::size_t n = 0;
+    while( parser.next_event() ) ++n;
+    return n;
+}
+
+//---------------------------------------------------------------------------
+template<text::Enc enc> [[nodiscard]] std::size_t count_batched_events(const std::string_view bytes, const std::size_t batch_size)
+{
+    xml::Parser<enc> parser{bytes, xml::Engine::STRUCTURAL_INDEX};
+    std::vector<xml::CompactEvent> batch(batch_size);
+    std::size_t n = 0;
+    while( const std::size_t got = parser.next_events(batch) ) n += got;
+    return n;
+}
+
+//---------------------------------------------------------------------------
+template<text::Enc enc> [[nodiscard]] std::size_t count_parallel_events(const std::string_view bytes, MG::thread_pool& pool)
+{
+    xml::ParallelParser<enc> parser{bytes, pool, {}, xml::Engine::STRUCTURAL_INDEX};
+    std::size_t n = 0;
+    while( parser.next_event() ) ++n;
+    return n;
+}
+
+//---------------------------------------------------------------------------
+template<text::Enc enc> void compare_engines(const std::string_view name, const std::string_view bytes)
+{
+    const double mb = static_cast<double>(bytes.size()) / 1E6;
+    std::size_t n_codepoint=0, n_structural=0;
+    const double t_codepoint = best_time_of([&]{ n_codepoint = count_events<enc>(bytes, xml::Engine::CODEPOINT); });
+    const double t_structural = best_time_of([&]{ n_structural = count_events<enc>(bytes, xml::Engine::STRUCTURAL_INDEX); });
+    fmt::print("{} ({:.1f}MB, {} events)\n", name, mb, n_codepoint);
+    fmt::print("    codepoint:        {:8.1f}ms {:8.1f}MB/s\n", 1E3*t_codepoint, mb/t_codepoint);
+    fmt::print("    structural index: {:8.1f}ms {:8.1f}MB/s (x{:.2f})\n", 1E3*t_structural, mb/t_structural, t_codepoint/t_structural);
+    if( n_structural!=n_codepoint )
+       {
+        fmt::print("    !! Events number mismatch: {}\n", n_structural);
+       }
+
+    std::size_t n_checked = 0;
+    const double t_checked = best_time_of([&]{ n_checked = count_events<enc>(bytes, xml::Engine::STRUCTURAL_INDEX, true); });
+    fmt::print("    nesting check:    {:8.1f}ms {:8.1f}MB/s ({:+.1f}%)\n", 1E3*t_checked, mb/t_checked, 100.0*(t_checked-t_structural)/t_structural);
+    if( n_checked!=n_codepoint )
+       {
+        fmt::print("    !! Events number mismatch: {}\n", n_checked);
+       }
+
+    for( const std::size_t batch_size : {1u, 16u, 256u} )
+       {
+        std::size_t n_batched = 0;
+        const double t_batched = best_time_of([&]{ n_batched = count_batched_events<enc>(bytes, batch_size); });
+        fmt::print("    batches of {:3}:   {:8.1f}ms {:8.2f}Mevents/s (x{:.2f} structural index)\n", batch_size, 1E3*t_batched, static_cast<double>(n_batched)/t_batched/1E6, t_structural/t_batched);
+        if( n_batched!=n_codepoint )
+           {
+            fmt::print("    !! Events number mismatch: {}\n", n_batched);
+           }
+       }
+
+    MG::thread_pool pool;
+    std::size_t n_parallel = 0;
+    const double t_parallel = best_time_of([&]{ n_parallel = count_parallel_events<enc>(bytes, pool); });
+    fmt::print("    parallel ({} threads): {:8.1f}ms {:8.1f}MB/s (x{:.2f})\n", pool.size(), 1E3*t_parallel, mb/t_parallel, t_codepoint/t_parallel);
+    if( n_parallel!=n_codepoint )
+       {
+        fmt::print("    !! Events number mismatch: {}\n", n_parallel);
+       }
+}
+
+//---------------------------------------------------------------------------
+// Many small files: a new parser for each or one reset
+void compare_parser_reuse(const std::string_view small_file, const std::size_t files_count)
+{
+    using enum text::Enc;
+    std::size_t n_new=0, n_reset=0;
+    const double t_new = best_time_of([&]
+       {
+        n_new = 0;
+        for( std::size_t i=0; i<files_count; ++i )
+           {
+            xml::Parser<UTF8> parser{small_file, xml::Engine::STRUCTURAL_INDEX};
+            parser.options().set_collect_text_sections(true);
+            while( parser.next_event() ) ++n_new;
+           }
+       });
+    const double t_reset = best_time_of([&]
+       {
+        n_reset = 0;
+        xml::Parser<UTF8> parser{""sv, xml::Engine::STRUCTURAL_INDEX};
+        parser.options().set_collect_text_sections(true);
+        for( std::size_t i=0; i<files_count; ++i )
+           {
+            parser.reset(small_file);
+            while( parser.next_event() ) ++n_reset;
+           }
+       });
+    fmt::print("{} small files ({} bytes each)\n", files_count, small_file.size());
+    fmt::print("    new parsers:      {:8.1f}ms\n", 1E3*t_new);
+    fmt::print("    reset parser:     {:8.1f}ms (x{:.2f})\n", 1E3*t_reset, t_new/t_reset);
+    if( n_reset!=n_new )
+       {
+        fmt::print("    !! Events number mismatch: {}\n", n_reset);
+       }
+}
+
+//---------------------------------------------------------------------------
+void compare_engines(const std::string_view name, const std::string_view bytes)
+{
+    switch( text::detect_encoding_of(bytes).enc )
+       {using enum text::Enc;
+        case UTF8: compare_engines<UTF8>(name, bytes); break;
+        case UTF16LE: compare_engines<UTF16LE>(name, bytes); break;
+        case UTF16BE: compare_engines<UTF16BE>(name, bytes); break;
+        case UTF32LE: compare_engines<UTF32LE>(name, bytes); break;
+        case UTF32BE: compare_engines<UTF32BE>(name, bytes); break;
+       }
+}
+
+}//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+
+//---------------------------------------------------------------------------
+int main( const int argc, const char* const argv[] )
+{
+    try{
+        if( argc>1 )
+           {
+            for( int i=1; i<argc; ++i )
+               {
+                const sys::memory_mapped_file mapped_file{std::string(argv[i])};
+                bench::compare_engines(argv[i], mapped_file.as_string_view());
+               }
+           }
+        else
+           {
+            const std::string utf8 = bench::synthetic_project(500);
+            bench::compare_engines("synthetic utf-8", utf8);
+            const std::string utf16 = text::to<text::Enc::UTF16LE>(U"\uFEFF"sv) + text::re_encode<text::Enc::UTF8,text::Enc::UTF16LE>(utf8);
+            bench::compare_engines("synthetic utf-16le", utf16);
+            bench::compare_parser_reuse(bench::synthetic_project(1), 2000);
+           }
+        return 0;
+       }
+    catch( std::exception& e )
+       {
+        fmt::print("!! {}\n", e.what());
+       }
+    return 2;
+}
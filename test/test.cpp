@@ -6,9 +6,23 @@ namespace ut = boost::ut;
 #define TEST_UNITS // Include units embedded tests
 #include "string_map.hpp" // MG::string_map<>
 #include "text.hpp" // text::*
+#include "text-scan.hpp" // text::find_any_of<>()
 #include "parser-base.hpp" // MG::ParserBase
+#include "xml-entities.hpp" // xml::decode_entities()
+#include "parser-xml-index.hpp" // xml::StructuralIndex
 #include "parser-xml.hpp" // xml::Parser
-//#include "project-updater.hpp" // ll::update_project()
+#include "thread_pool.hpp" // MG::thread_pool
+#include "parser-xml-parallel.hpp" // xml::ParallelParser
+#include "xml-tape.hpp" // xml::Tape
+#include "generator.hpp" // MG::generator<>
+#include "xml-pipeline.hpp" // xml::events_of(), ...
+#include "timings.hpp" // sys::scoped_timer
+#include "memory_mapped_file.hpp" // sys::memory_mapped_file
+#include "splice_writer.hpp" // sys::splice_writer
+#include "library-cache.hpp" // ll::library_cache
+#include "update-manifest.hpp" // ll::update_manifest
+#include "project-index.hpp" // ll::project_index
+#include "project-updater.hpp" // ll::update_project()
 
 
 //---------------------------------------------------------------------------